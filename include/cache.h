@@ -0,0 +1,85 @@
+/* cache.h defines an in-process cache with a byte or entry budget.
+ *
+ * Entries live in a chained hash table (see hash.h), and each one
+ * embeds a list_node (see list.h) linking it into the eviction order,
+ * so a hit, an insertion and an eviction all take O(1) time. When a
+ * put goes over budget, entries are evicted from the tail:
+ *
+ * CACHE_LRU: a hit moves the entry to the head of the list, and the
+ * least recently used entry is evicted first;
+ * CACHE_CLOCK: a hit only sets the entry's reference bit; eviction
+ * gives each referenced entry a second chance by clearing its bit and
+ * moving it to the head. Hits in a shard_cache then need no write lock.
+ *
+ * A shard_cache splits the key space over independent caches, each
+ * with its own lock and a share of the budget, routing keys as a
+ * shard_hash does (see hash_shard.h).
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "hash.h"
+
+enum cache_policy {
+	CACHE_LRU,
+	CACHE_CLOCK,
+};
+
+/* fields left zero take their default value */
+struct cache_init {
+	size_t key_size;
+	size_t value_size;
+	/* compare and hash keys; NULL hash_func hashes the key bytes */
+	cmp_func cmp_func;
+	hash_func hash_func;
+	/* budgets; zero means unlimited */
+	size_t max_entries;
+	size_t max_bytes;
+	/* one of enum cache_policy */
+	int policy;
+};
+
+struct cache_stats {
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+	size_t entries;
+	size_t bytes;
+};
+
+typedef struct cache cache;
+typedef struct shard_cache shard_cache;
+
+/* return NULL if failed */
+cache *cache_init(struct cache_init *c_init);
+/* search key and copy its value to value if value is not NULL */
+/* return true on a hit */
+bool cache_get(cache *c, const void *key, void *value);
+/* add or replace the value of key, charging it charge bytes */
+/* (0 for key_size + value_size), and evict entries while over */
+/* budget, though never the entry just put */
+/* return false if failed */
+bool cache_put(cache *c, const void *key, const void *value, size_t charge);
+/* return true if key was found and deleted */
+bool cache_delete(cache *c, const void *key);
+void cache_stats(cache *c, struct cache_stats *st);
+/* hash code of key, as the table of c computes it */
+uint64_t cache_code(const cache *c, const void *key);
+void cache_free(cache *c);
+
+/* a cache of nshards shards (0 for SHARD_CACHE_COUNT) */
+#define SHARD_CACHE_COUNT (16)
+shard_cache *shard_cache_init(struct cache_init *c_init, size_t nshards);
+bool shard_cache_get(shard_cache *s, const void *key, void *value);
+bool shard_cache_put(shard_cache *s, const void *key, const void *value,
+		size_t charge);
+bool shard_cache_delete(shard_cache *s, const void *key);
+/* sum of the stats of all shards */
+void shard_cache_stats(shard_cache *s, struct cache_stats *st);
+void shard_cache_free(shard_cache *s);
+
+#endif
@@ -0,0 +1,54 @@
+/* epoch.h defines epoch-based memory reclamation.
+ *
+ * Readers announce themselves with epoch_enter/epoch_exit around the
+ * accesses to a shared structure, which only writes to their own
+ * record. A writer that unlinks an object passes it to epoch_retire
+ * instead of freeing it; the object is freed once the global epoch
+ * has advanced twice, since by then no reader that could have seen
+ * it is still inside its critical section.
+ *
+ * operations on epoch:
+ * register: get a record for a reading thread;
+ * enter/exit: delimit a read-side critical section (not nestable);
+ * retire: free an unlinked object after a grace period;
+ * synchronize: wait until every retired object has been freed.
+ */
+
+#ifndef _EPOCH_H
+#define _EPOCH_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* try to advance the epoch every EPOCH_ADVANCE_RATE retirements */
+#define EPOCH_ADVANCE_RATE (64)
+
+/* structure epoch_entry is embedded in objects to be retired */
+struct epoch_entry {
+	struct epoch_entry *next;
+	void (*free)(struct epoch_entry *);
+};
+
+struct epoch;
+struct epoch_record;
+
+/* allocate an epoch manager */
+struct epoch *epoch_init(void);
+/* get a record for the calling thread, NULL if failed */
+struct epoch_record *epoch_register(struct epoch *e);
+/* give back a record of a thread that no longer reads */
+void epoch_unregister(struct epoch *e, struct epoch_record *r);
+/* begin and end a read-side critical section */
+void epoch_enter(struct epoch_record *r);
+void epoch_exit(struct epoch_record *r);
+/* call entry->free(entry) when no reader can still see it */
+void epoch_retire(struct epoch *e, struct epoch_entry *entry);
+/* try to advance the global epoch and free what has become safe */
+/* return true if the epoch advanced */
+bool epoch_advance(struct epoch *e);
+/* wait for all readers to leave and free all retired entries */
+void epoch_synchronize(struct epoch *e);
+/* free e and every retired entry; nobody may read any more */
+void epoch_free(struct epoch *e);
+
+#endif
@@ -0,0 +1,76 @@
+/* hash_join.h defines column-at-a-time hash join and group-by
+ * operators over 64-bit keys.
+ *
+ * Rows are given as columns, key i of a column being row i, and are
+ * processed JOIN_BATCH at a time: the codes of a whole batch are
+ * computed in one tight loop and their groups prefetched before any
+ * is probed, and the 16 tags of a group are compared at once, as in
+ * HASH_SWISS tables. Keys are compared as integers, with no callback.
+ *
+ * The build side of a join is radix-partitioned by the upper bits of
+ * the codes into tables of about JOIN_PART_BYTES, each of which is
+ * filled while it stays in cache. Equal build keys are all kept, and
+ * a probe reports every match as a pair of row ids.
+ *
+ * A group table keeps the count, sum, minimum and maximum of the
+ * values of each distinct key, updated in place.
+ */
+
+#ifndef _HASH_JOIN_H
+#define _HASH_JOIN_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* rows hashed and prefetched together */
+#define JOIN_BATCH (1024)
+/* size of a partition of the build side, about that of a L2 cache */
+#define JOIN_PART_BYTES (1<<18)
+
+typedef struct join_table join_table;
+typedef struct group_table group_table;
+
+/* matching row ids of the build and probe sides, as two columns */
+/* of n entries; zero it before the first join_probe */
+struct join_result {
+	uint32_t *build;
+	uint32_t *probe;
+	size_t n;
+	size_t cap;
+};
+
+struct group_row {
+	uint64_t key;
+	uint64_t count;
+	int64_t sum;
+	int64_t min;
+	int64_t max;
+};
+
+/* build a table over n keys, of rows 0 to n - 1 */
+/* return NULL if failed */
+join_table *join_build(const uint64_t *keys, size_t n);
+/* probe t with n keys of rows first_row, first_row + 1, ..., and */
+/* append the pairs of matching rows to res, in no particular order */
+/* return false if failed */
+bool join_probe(const join_table *t, const uint64_t *keys, size_t n,
+		uint32_t first_row, struct join_result *res);
+void join_result_free(struct join_result *res);
+void join_free(join_table *t);
+
+/* allocate a group table for about size keys; zero means default */
+group_table *group_init(size_t size);
+/* add value i to the group of key i, for i in [0, n) */
+/* return false if failed */
+bool group_add(group_table *g, const uint64_t *keys, const int64_t *values,
+		size_t n);
+/* return the row of key, or NULL */
+const struct group_row *group_find(const group_table *g, uint64_t key);
+/* return the row at cursor *pos and advance it, or NULL at the end; */
+/* zero *pos before the first call */
+const struct group_row *group_next(const group_table *g, size_t *pos);
+size_t group_nmembs(const group_table *g);
+void group_free(group_table *g);
+
+#endif
@@ -0,0 +1,52 @@
+/* hash_mph.h defines minimal perfect hash tables for sets of keys
+ * that are built once and then only read.
+ *
+ * A table of n elements maps every key it holds to its own slot in
+ * [0, n), so a search computes one hash code, reads one small pilot
+ * and compares the key in one slot; elements, values included, are
+ * stored inline in the slots. The metadata is a 16-bit pilot per
+ * bucket of about six keys, plus a short remap array, a little over
+ * 3 bits per key in all.
+ *
+ * A search for a key that is not in the set lands on some slot too,
+ * and returns NULL when the key there differs. A table can be written
+ * to a file and mapped back, read-only, at any address.
+ */
+
+#ifndef _HASH_MPH_H
+#define _HASH_MPH_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "hash.h"
+
+/* average number of keys per bucket */
+#define MPH_BUCKET_LOAD (6)
+
+typedef struct mph mph;
+
+/* build a table holding the elements of h, keeping its layout and */
+/* callbacks; h is left unchanged and may be freed afterwards */
+/* return NULL if failed */
+mph *mph_from_hash(hash *h);
+/* build a table from n elements of data laid out as described by */
+/* h_init; of equal elements the last one is kept */
+/* return NULL if failed */
+mph *mph_build(struct hash_init *h_init, const void *data, size_t n);
+/* return a pointer to the element equal to data, or NULL */
+void *mph_search(const mph *p, const void *data);
+/* value part of an element of a table built from a map */
+void *mph_value(const mph *p, const void *data);
+size_t mph_nmembs(const mph *p);
+/* bytes of metadata, leaving out the elements themselves */
+size_t mph_meta_bytes(const mph *p);
+/* write p to a file that mph_map can map back */
+/* return true if written successfully */
+bool mph_save(const mph *p, const char *path);
+/* map a file written by mph_save, using the callbacks in h_init, */
+/* which must match the saved table */
+/* return NULL if failed */
+mph *mph_map(const char *path, struct hash_init *h_init);
+void mph_free(mph *p);
+
+#endif
@@ -0,0 +1,39 @@
+/* hash_multi.h defines a multimap on top of a hash map.
+ *
+ * A key may have any number of values. All values of a key are kept
+ * one after another in a run of their own, which doubles when full,
+ * so hash_equal_range returns them as one array and scanning them is
+ * a sequential read. The map holds each key once, with its run.
+ *
+ * The callbacks and the engine are given as for a map: key_size,
+ * value_size, cmp_func and hash_func, and optionally type and size.
+ */
+
+#ifndef _HASH_MULTI_H
+#define _HASH_MULTI_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "hash.h"
+
+typedef struct hash_multi hash_multi;
+
+/* return NULL if failed */
+hash_multi *hash_multi_init(struct hash_init *h_init);
+/* append value to the values of key; return false if failed */
+bool hash_multi_insert(hash_multi *m, const void *key, const void *value);
+/* return the values of key, *count of them one after another, or */
+/* NULL if key is absent; the pointer is valid until the values of */
+/* key change */
+void *hash_equal_range(hash_multi *m, const void *key, size_t *count);
+/* remove value i of key, moving the last value of key into its */
+/* place; return false if there is no such value */
+bool hash_multi_erase(hash_multi *m, const void *key, size_t i);
+/* remove key and all its values; return false if key is absent */
+bool hash_multi_delete(hash_multi *m, const void *key);
+/* number of keys, and of values of all keys */
+size_t hash_multi_nkeys(const hash_multi *m);
+size_t hash_multi_nvalues(const hash_multi *m);
+void hash_multi_free(hash_multi *m);
+
+#endif
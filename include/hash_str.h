@@ -0,0 +1,49 @@
+/* hash_str.h defines a map keyed by interned strings.
+ *
+ * The bytes of every string are appended to one arena; the table
+ * itself only holds (hash, length, offset) records, so keys of any
+ * length cost their own size and a lookup compares the hash and the
+ * length before touching the bytes. Each distinct string gets an id,
+ * counting up from zero, which stays valid until the string is
+ * deleted, after which it is given to a later string; a value of
+ * value_size bytes is kept for every id, in one array. The
+ * bytes of deleted strings are reclaimed by compacting the arena.
+ */
+
+#ifndef _HASH_STR_H
+#define _HASH_STR_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+typedef struct str_hash str_hash;
+
+/* allocate a table for about size strings (zero means default), */
+/* each with a value of value_size bytes, which may be zero */
+str_hash *str_init(size_t size, size_t value_size);
+/* set *id to the id of the len bytes at s, adding them with a zeroed */
+/* value if absent; return false if failed */
+bool str_intern(str_hash *h, const char *s, size_t len, size_t *id);
+/* set *id to the id of the len bytes at s */
+/* return false if they have not been interned */
+bool str_lookup(const str_hash *h, const char *s, size_t len, size_t *id);
+/* intern the len bytes at s and copy value to their value */
+/* return false if failed, or the table has no values */
+bool str_put(str_hash *h, const char *s, size_t len, const void *value);
+/* delete the len bytes at s; their id may be given to a later string */
+/* return false if they have not been interned */
+bool str_delete(str_hash *h, const char *s, size_t len);
+/* return the NUL-terminated string of id and set *len if len is */
+/* not NULL; the pointer is valid until the next str_intern, */
+/* str_put or str_delete. return NULL if there is no such id */
+const char *str_get(const str_hash *h, size_t id, size_t *len);
+/* return the value of id, valid until the next str_intern or */
+/* str_put; NULL if there is no such id or the table has no values */
+void *str_value(const str_hash *h, size_t id);
+/* number of strings */
+size_t str_nmembs(const str_hash *h);
+/* memory held by the table and its arena */
+size_t str_bytes(const str_hash *h);
+void str_free(str_hash *h);
+
+#endif
@@ -0,0 +1,65 @@
+/* ttl.h defines a map whose entries expire at a given time.
+ *
+ * Entries live in a chained hash table (see hash.h), and each one
+ * embeds a list_node (see list.h) linking it into a hierarchical
+ * timing wheel: TTL_LEVELS levels of TTL_SLOTS slots, where a slot of
+ * level l covers TTL_SLOTS^l ticks. An entry goes into the slot of
+ * the lowest level that reaches its expiry time, and moves down a
+ * level whenever the wheel turns past a slot of a higher one, so
+ * putting, refreshing, deleting and expiring an entry take O(1)
+ * amortized time, and no call ever scans the whole table.
+ *
+ * Time is counted in ticks of the caller's choosing (milliseconds,
+ * seconds, ...), and only moves forward. An expired entry is dropped
+ * lazily when ttl_get meets it, and in bounded batches by ttl_expire.
+ */
+
+#ifndef _TTL_H
+#define _TTL_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "hash.h"
+
+#define TTL_SLOTS (64)
+#define TTL_LEVELS (4)
+
+/* fields left zero take their default value */
+struct ttl_init {
+	size_t key_size;
+	size_t value_size;
+	/* compare and hash keys; NULL hash_func hashes the key bytes */
+	cmp_func cmp_func;
+	hash_func hash_func;
+	/* expected number of entries */
+	size_t size;
+	/* tick the wheel starts at */
+	uint64_t now;
+	/* called on every entry dropped because it expired */
+	void (*on_expire)(const void *key, void *value, void *arg);
+	void *arg;
+};
+
+typedef struct ttl_map ttl_map;
+
+/* return NULL if failed */
+ttl_map *ttl_init(struct ttl_init *t_init);
+/* search key and copy its value to value if value is not NULL */
+/* return false if absent, or expired at tick now */
+bool ttl_get(ttl_map *t, const void *key, void *value, uint64_t now);
+/* add or replace the value of key, to expire at tick expire */
+/* return false if failed */
+bool ttl_put(ttl_map *t, const void *key, const void *value,
+		uint64_t expire);
+/* return true if key was found and deleted */
+bool ttl_delete(ttl_map *t, const void *key);
+/* turn the wheel up to tick now, dropping expired entries, but at */
+/* most budget of them (0 for no limit); the rest are dropped by */
+/* later calls. return the number of entries dropped */
+size_t ttl_expire(ttl_map *t, uint64_t now, size_t budget);
+/* number of entries, expired ones not yet dropped included */
+size_t ttl_nmembs(const ttl_map *t);
+void ttl_free(ttl_map *t);
+
+#endif
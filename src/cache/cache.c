@@ -0,0 +1,246 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cache.h"
+#include "list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+
+/*
+ *    list --> entry <--> entry <--> ... <--> entry
+ *             (head)                         (tail, evicted first)
+ *
+ * Every element of the hash table is a key followed by a cache_entry
+ * holding the list node, the charge, the reference bit and the value.
+ * Chained tables never move their elements, so the list can link them
+ * directly, and an entry finds its key at a fixed offset before it.
+ *
+ * Hits and misses are counted in COUNTER_STRIPES cache-line sized
+ * stripes, each thread bumping its own, so that concurrent readers of
+ * a shard_cache write to no shared line; cache_stats sums them.
+ */
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define CACHE_LINE 64
+#define COUNTER_STRIPES 16
+
+/* counters may be bumped by concurrent readers of a shard_cache, */
+/* which only share a stripe when there are more than COUNTER_STRIPES */
+#define COUNT(c, x) __atomic_fetch_add(&(c)->counters[my_stripe()].x, \
+		1, __ATOMIC_RELAXED)
+
+struct counters {
+	size_t hits;
+	size_t misses;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct cache_entry {
+	struct list_node node;
+	size_t charge;
+	unsigned char ref;
+	unsigned char value[];
+};
+
+struct cache {
+	hash *h;
+	struct list_head list;
+	size_t key_size;
+	size_t value_size;
+	size_t max_entries;
+	size_t max_bytes;
+	size_t bytes;
+	int policy;
+	struct counters *counters;
+	size_t evictions;
+	/* element-sized buffer for hash_delete */
+	unsigned char *scratch;
+};
+
+/* the stripe of the calling thread, given out round robin */
+static unsigned int my_stripe(void)
+{
+	static unsigned int next;
+	static __thread unsigned int stripe;
+
+	if(!stripe)
+		stripe = __atomic_add_fetch(&next, 1, __ATOMIC_RELAXED);
+	return stripe % COUNTER_STRIPES;
+}
+
+static void *key_of(cache *c, struct cache_entry *e)
+{
+	return (unsigned char *)e - c->h->value_offset;
+}
+
+/* unlink e and delete it from the table */
+static void cache_remove(cache *c, struct cache_entry *e)
+{
+	list_del(&e->node);
+	c->bytes -= e->charge;
+	memcpy(c->scratch, key_of(c, e), c->key_size);
+	hash_delete(c->h, c->scratch);
+}
+
+static bool over_budget(cache *c)
+{
+	return (c->max_entries && c->h->nmembs > c->max_entries) ||
+		(c->max_bytes && c->bytes > c->max_bytes);
+}
+
+/* evict from the tail until within budget, sparing keep */
+static void cache_evict(cache *c, struct cache_entry *keep)
+{
+	while(over_budget(c) && c->h->nmembs > 1) {
+		struct cache_entry *e = container_of(list_tail(&c->list),
+				struct cache_entry, node);
+		/* second chance */
+		if(e == keep || (c->policy == CACHE_CLOCK && e->ref)) {
+			e->ref = 0;
+			list_del(&e->node);
+			list_add_head(&c->list, &e->node);
+			continue;
+		}
+		cache_remove(c, e);
+		c->evictions++;
+	}
+}
+
+cache *cache_init(struct cache_init *c_init)
+{
+	if(!c_init || !c_init->key_size || !c_init->cmp_func ||
+			(c_init->policy != CACHE_LRU &&
+			 c_init->policy != CACHE_CLOCK)) {
+		hash_error("incorrect cache_init structure");
+		return NULL;
+	}
+	cache *c = (cache *)malloc(sizeof(cache));
+	struct hash_init h_init;
+
+	if(!c) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.type = HASH_CHAINED;
+	h_init.size = c_init->max_entries;
+	h_init.key_size = c_init->key_size;
+	h_init.value_size = sizeof(struct cache_entry) + c_init->value_size;
+	h_init.cmp_func = c_init->cmp_func;
+	h_init.hash_func = c_init->hash_func;
+	c->h = hash_init(&h_init);
+	c->scratch = c->h ? (unsigned char *)malloc(c->h->data_size) : NULL;
+	if(!c->scratch || posix_memalign((void **)&c->counters, CACHE_LINE,
+				COUNTER_STRIPES * sizeof(struct counters))) {
+		hash_error("failed to allocate memory");
+		hash_free(c->h);
+		free(c->scratch);
+		free(c);
+		return NULL;
+	}
+	memset(c->counters, 0, COUNTER_STRIPES * sizeof(struct counters));
+	INIT_LIST_HEAD(&c->list);
+	c->key_size = c_init->key_size;
+	c->value_size = c_init->value_size;
+	c->max_entries = c_init->max_entries;
+	c->max_bytes = c_init->max_bytes;
+	c->bytes = 0;
+	c->policy = c_init->policy;
+	c->evictions = 0;
+	return c;
+}
+
+/* a CACHE_CLOCK hit writes nothing but the reference bit and the */
+/* counters, so shard_cache runs it under a read lock */
+bool cache_get(cache *c, const void *key, void *value)
+{
+	void *data = hash_find(c->h, key);
+	struct cache_entry *e;
+
+	if(!data) {
+		COUNT(c, misses);
+		return false;
+	}
+	e = (struct cache_entry *)hash_value(c->h, data);
+	if(c->policy == CACHE_LRU) {
+		list_del(&e->node);
+		list_add_head(&c->list, &e->node);
+	} else if(!__atomic_load_n(&e->ref, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&e->ref, 1, __ATOMIC_RELAXED);
+	}
+	COUNT(c, hits);
+	if(value)
+		memcpy(value, e->value, c->value_size);
+	return true;
+}
+
+bool cache_put(cache *c, const void *key, const void *value, size_t charge)
+{
+	bool inserted;
+	struct cache_entry *e = (struct cache_entry *)
+		hash_get_or_insert(c->h, key, &inserted);
+
+	if(!e) return false;
+	if(!charge)
+		charge = c->key_size + c->value_size;
+	if(inserted) {
+		list_add_head(&c->list, &e->node);
+	} else {
+		c->bytes -= e->charge;
+		if(c->policy == CACHE_LRU) {
+			list_del(&e->node);
+			list_add_head(&c->list, &e->node);
+		} else {
+			e->ref = 1;
+		}
+	}
+	e->charge = charge;
+	c->bytes += charge;
+	memcpy(e->value, value, c->value_size);
+	cache_evict(c, e);
+	return true;
+}
+
+bool cache_delete(cache *c, const void *key)
+{
+	void *data = hash_find(c->h, key);
+	if(!data) return false;
+	cache_remove(c, (struct cache_entry *)hash_value(c->h, data));
+	return true;
+}
+
+uint64_t cache_code(const cache *c, const void *key)
+{
+	return hash_code(c->h, key);
+}
+
+void cache_stats(cache *c, struct cache_stats *st)
+{
+	int i;
+
+	st->hits = 0;
+	st->misses = 0;
+	for(i = 0; i < COUNTER_STRIPES; i++) {
+		st->hits += __atomic_load_n(&c->counters[i].hits,
+				__ATOMIC_RELAXED);
+		st->misses += __atomic_load_n(&c->counters[i].misses,
+				__ATOMIC_RELAXED);
+	}
+	st->evictions = c->evictions;
+	st->entries = c->h->nmembs;
+	st->bytes = c->bytes;
+}
+
+void cache_free(cache *c)
+{
+	if(!c) return;
+	hash_free(c->h);
+	free(c->scratch);
+	free(c->counters);
+	free(c);
+}
@@ -0,0 +1,151 @@
+#define _POSIX_C_SOURCE 200809L
+#include "cache.h"
+#include "hash_shard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#define CACHE_LINE 64
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+/* each shard takes whole cache lines, so that taking the lock of
+ * one shard never invalidates the line of another */
+struct shard {
+	pthread_rwlock_t lock;
+	cache *c;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct shard_cache {
+	struct shard *shards;
+	size_t nshards;
+	/* 64 - log2(nshards), 64 meaning a single shard */
+	int shift;
+	int policy;
+};
+
+static struct shard *shard_of(shard_cache *s, const void *key)
+{
+	return &s->shards[shard_pick(cache_code(s->shards[0].c, key),
+			s->shift)];
+}
+
+shard_cache *shard_cache_init(struct cache_init *c_init, size_t nshards)
+{
+	if(!c_init) {
+		hash_error("incorrect cache_init structure");
+		return NULL;
+	}
+	shard_cache *s = (shard_cache *)malloc(sizeof(shard_cache));
+	struct cache_init init = *c_init;
+	size_t n, i;
+	int shift;
+
+	if(!s) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	n = shard_round(nshards ? nshards : SHARD_CACHE_COUNT, &shift);
+	if(posix_memalign((void **)&s->shards, CACHE_LINE,
+				n * sizeof(struct shard))) {
+		hash_error("failed to allocate memory");
+		free(s);
+		return NULL;
+	}
+	/* split the budgets, rounding up */
+	if(init.max_entries)
+		init.max_entries = (init.max_entries + n - 1) / n;
+	if(init.max_bytes)
+		init.max_bytes = (init.max_bytes + n - 1) / n;
+	for(i = 0; i < n; i++) {
+		s->shards[i].c = cache_init(&init);
+		if(!s->shards[i].c ||
+				pthread_rwlock_init(&s->shards[i].lock, NULL)) {
+			hash_error("failed to initialize shard");
+			cache_free(s->shards[i].c);
+			while(i-- > 0) {
+				pthread_rwlock_destroy(&s->shards[i].lock);
+				cache_free(s->shards[i].c);
+			}
+			free(s->shards);
+			free(s);
+			return NULL;
+		}
+	}
+	s->nshards = n;
+	s->shift = shift;
+	s->policy = c_init->policy;
+	return s;
+}
+
+bool shard_cache_get(shard_cache *s, const void *key, void *value)
+{
+	struct shard *sh = shard_of(s, key);
+	bool res;
+
+	/* an LRU hit reorders the list */
+	if(s->policy == CACHE_CLOCK)
+		pthread_rwlock_rdlock(&sh->lock);
+	else
+		pthread_rwlock_wrlock(&sh->lock);
+	res = cache_get(sh->c, key, value);
+	pthread_rwlock_unlock(&sh->lock);
+	return res;
+}
+
+bool shard_cache_put(shard_cache *s, const void *key, const void *value,
+		size_t charge)
+{
+	struct shard *sh = shard_of(s, key);
+	bool res;
+
+	pthread_rwlock_wrlock(&sh->lock);
+	res = cache_put(sh->c, key, value, charge);
+	pthread_rwlock_unlock(&sh->lock);
+	return res;
+}
+
+bool shard_cache_delete(shard_cache *s, const void *key)
+{
+	struct shard *sh = shard_of(s, key);
+	bool res;
+
+	pthread_rwlock_wrlock(&sh->lock);
+	res = cache_delete(sh->c, key);
+	pthread_rwlock_unlock(&sh->lock);
+	return res;
+}
+
+void shard_cache_stats(shard_cache *s, struct cache_stats *st)
+{
+	size_t i;
+
+	memset(st, 0, sizeof(struct cache_stats));
+	for(i = 0; i < s->nshards; i++) {
+		struct cache_stats x;
+		pthread_rwlock_rdlock(&s->shards[i].lock);
+		cache_stats(s->shards[i].c, &x);
+		pthread_rwlock_unlock(&s->shards[i].lock);
+		st->hits += x.hits;
+		st->misses += x.misses;
+		st->evictions += x.evictions;
+		st->entries += x.entries;
+		st->bytes += x.bytes;
+	}
+}
+
+void shard_cache_free(shard_cache *s)
+{
+	size_t i;
+
+	if(!s) return;
+	for(i = 0; i < s->nshards; i++) {
+		pthread_rwlock_destroy(&s->shards[i].lock);
+		cache_free(s->shards[i].c);
+	}
+	free(s->shards);
+	free(s);
+}
@@ -0,0 +1,87 @@
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NTHREADS 8
+#define PER_THREAD (1<<16)
+#define NKEYS (1<<12)
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+shard_cache *s;
+
+/* each thread puts keys id, id + NTHREADS, ... and reads all keys; */
+/* a value is always the negated key */
+void *worker(void *arg)
+{
+	int id = (int)(long)arg;
+	int i, key;
+	long value;
+
+	for(i = 0; i < PER_THREAD; i++) {
+		key = (i * NTHREADS + id) % (4 * NKEYS);
+		value = -key;
+		if(!shard_cache_put(s, &key, &value, 0))
+			return (void *)1;
+		key = (key * 7 + 1) % (4 * NKEYS);
+		if(shard_cache_get(s, &key, &value) && value != -key)
+			return (void *)1;
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t threads[NTHREADS];
+	struct cache_init c_init;
+	struct cache_stats st;
+	long i;
+	int policy;
+	void *res;
+
+	for(policy = CACHE_LRU; policy <= CACHE_CLOCK; policy++) {
+		memset(&c_init, 0, sizeof(c_init));
+		c_init.key_size = sizeof(int);
+		c_init.value_size = sizeof(long);
+		c_init.cmp_func = compare;
+		c_init.hash_func = hash_int;
+		c_init.max_entries = NKEYS;
+		c_init.policy = policy;
+		s = shard_cache_init(&c_init, 16);
+		if(!s) {
+			fprintf(stderr, "failed to initialize cache\n");
+			goto FAILED;
+		}
+		for(i = 0; i < NTHREADS; i++)
+			pthread_create(&threads[i], NULL, worker, (void *)i);
+		for(i = 0; i < NTHREADS; i++) {
+			pthread_join(threads[i], &res);
+			if(res) {
+				fprintf(stderr, "thread %ld error\n", i);
+				goto FAILED;
+			}
+		}
+		shard_cache_stats(s, &st);
+		if(st.hits + st.misses != NTHREADS * PER_THREAD ||
+				st.entries > NKEYS || st.evictions == 0) {
+			fprintf(stderr, "stats error\n");
+			goto FAILED;
+		}
+		shard_cache_free(s);
+	}
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
@@ -0,0 +1,115 @@
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define NKEYS 100
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+int main(void)
+{
+	cache *c;
+	struct cache_init c_init;
+	struct cache_stats st;
+	int i, policy;
+	long value;
+
+	for(policy = CACHE_LRU; policy <= CACHE_CLOCK; policy++) {
+		memset(&c_init, 0, sizeof(c_init));
+		c_init.key_size = sizeof(int);
+		c_init.value_size = sizeof(long);
+		c_init.cmp_func = compare;
+		c_init.max_entries = NKEYS;
+		c_init.policy = policy;
+		c = cache_init(&c_init);
+		if(!c) {
+			fprintf(stderr, "failed to initialize cache\n");
+			goto FAILED;
+		}
+		for(i = 0; i < NKEYS; i++) {
+			value = -i;
+			if(!cache_put(c, &i, &value, 0)) {
+				fprintf(stderr, "put error\n");
+				goto FAILED;
+			}
+		}
+		/* use the older half, then push in NKEYS / 2 new keys: */
+		/* both policies evict the half not used */
+		for(i = 0; i < NKEYS / 2; i++) {
+			if(!cache_get(c, &i, &value) || value != -i) {
+				fprintf(stderr, "get error\n");
+				goto FAILED;
+			}
+		}
+		for(i = NKEYS; i < NKEYS + NKEYS / 2; i++) {
+			value = -i;
+			cache_put(c, &i, &value, 0);
+		}
+		for(i = 0; i < NKEYS + NKEYS / 2; i++) {
+			bool hit = cache_get(c, &i, &value);
+			if(hit != (i < NKEYS / 2 || i >= NKEYS) ||
+					(hit && value != -i)) {
+				fprintf(stderr, "eviction error\n");
+				goto FAILED;
+			}
+		}
+		cache_stats(c, &st);
+		if(st.entries != NKEYS || st.evictions != NKEYS / 2 ||
+				st.hits != NKEYS / 2 + NKEYS ||
+				st.misses != NKEYS / 2) {
+			fprintf(stderr, "stats error\n");
+			goto FAILED;
+		}
+		i = 0;
+		if(!cache_delete(c, &i) || cache_get(c, &i, NULL) ||
+				cache_delete(c, &i)) {
+			fprintf(stderr, "delete error\n");
+			goto FAILED;
+		}
+		cache_free(c);
+	}
+
+	/* a byte budget, with charges larger than entries */
+	c_init.max_entries = 0;
+	c_init.max_bytes = 1000;
+	c_init.policy = CACHE_LRU;
+	c = cache_init(&c_init);
+	if(!c) {
+		fprintf(stderr, "failed to initialize cache\n");
+		goto FAILED;
+	}
+	for(i = 0; i < NKEYS; i++) {
+		value = i;
+		cache_put(c, &i, &value, 100);
+	}
+	cache_stats(c, &st);
+	if(st.entries != 10 || st.bytes != 1000 ||
+			!cache_get(c, &(int){ NKEYS - 1 }, NULL) ||
+			cache_get(c, &(int){ NKEYS - 11 }, NULL)) {
+		fprintf(stderr, "budget error\n");
+		goto FAILED;
+	}
+	/* an entry over the whole budget evicts everything else */
+	value = 0;
+	cache_put(c, &i, &value, 5000);
+	cache_stats(c, &st);
+	if(st.entries != 1 || st.bytes != 5000) {
+		fprintf(stderr, "budget error\n");
+		goto FAILED;
+	}
+	cache_free(c);
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
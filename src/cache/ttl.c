@@ -0,0 +1,270 @@
+#include "ttl.h"
+#include "list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+
+/*
+ *    level 3: | | | ... | |   slot: TTL_SLOTS^3 ticks
+ *    level 2: | | | ... | |   slot: TTL_SLOTS^2 ticks
+ *    level 1: | | | ... | |   slot: TTL_SLOTS ticks
+ *    level 0: | | | ... | |   slot: 1 tick
+ *              |
+ *              entry <--> entry <--> ...
+ *
+ * Slot i of level l holds the entries whose expiry, shifted right by
+ * l * SLOT_BITS, is i modulo TTL_SLOTS. cur is the first tick whose
+ * level 0 slot has not been emptied yet; when it crosses a multiple
+ * of TTL_SLOTS^l, the matching slot of level l is emptied into the
+ * levels below (cascading). Entries past the reach of the top level
+ * are put in the last slot it reaches, and placed again from there.
+ * A bitmap of the slots in use lets the wheel skip over idle ticks,
+ * so turning it costs O(TTL_LEVELS) per slot emptied.
+ * As in cache.c, each element of the hash table is a key followed by
+ * a ttl_entry, which finds its key at a fixed offset before it.
+ */
+
+#define SLOT_BITS 6
+#define SLOT_MASK (TTL_SLOTS - 1)
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+struct ttl_entry {
+	struct list_node node;
+	uint64_t expire;
+	/* slot holding the entry; 32 bits wide so that value is aligned */
+	uint32_t level;
+	uint32_t slot;
+	unsigned char value[];
+};
+
+struct ttl_map {
+	hash *h;
+	struct list_head wheel[TTL_LEVELS][TTL_SLOTS];
+	/* bit i of used[l] set if slot i of level l is not empty */
+	uint64_t used[TTL_LEVELS];
+	uint64_t cur;
+	size_t key_size;
+	size_t value_size;
+	void (*on_expire)(const void *key, void *value, void *arg);
+	void *arg;
+	/* element-sized buffer for hash_delete */
+	unsigned char *scratch;
+};
+
+static void *key_of(ttl_map *t, struct ttl_entry *e)
+{
+	return (unsigned char *)e - t->h->value_offset;
+}
+
+/* link e into the slot reaching its expiry, as seen from cur */
+static void ttl_place(ttl_map *t, struct ttl_entry *e)
+{
+	uint64_t expire = e->expire < t->cur ? t->cur : e->expire;
+	uint64_t delta = expire - t->cur;
+	int l;
+
+	for(l = 0; l < TTL_LEVELS - 1; l++)
+		if(delta >> ((l + 1) * SLOT_BITS) == 0)
+			break;
+	if(delta >> (TTL_LEVELS * SLOT_BITS))
+		expire = t->cur + ((uint64_t)1 << (TTL_LEVELS * SLOT_BITS)) - 1;
+	e->level = (uint32_t)l;
+	e->slot = (uint32_t)((expire >> (l * SLOT_BITS)) & SLOT_MASK);
+	list_add_tail(&t->wheel[l][e->slot], &e->node);
+	t->used[l] |= (uint64_t)1 << e->slot;
+}
+
+static void ttl_unlink(ttl_map *t, struct ttl_entry *e)
+{
+	list_del(&e->node);
+	if(list_is_empty(&t->wheel[e->level][e->slot]))
+		t->used[e->level] &= ~((uint64_t)1 << e->slot);
+}
+
+/* unlink e and delete it from the table */
+static void ttl_remove(ttl_map *t, struct ttl_entry *e)
+{
+	ttl_unlink(t, e);
+	memcpy(t->scratch, key_of(t, e), t->key_size);
+	hash_delete(t->h, t->scratch);
+}
+
+static void ttl_drop(ttl_map *t, struct ttl_entry *e)
+{
+	if(t->on_expire)
+		t->on_expire(key_of(t, e), e->value, t->arg);
+	ttl_remove(t, e);
+}
+
+/* place again the entries of slot i of level l */
+static void ttl_cascade(ttl_map *t, int l, size_t i)
+{
+	struct list_head tmp;
+	struct list_node *pos, *next;
+
+	INIT_LIST_HEAD(&tmp);
+	list_merge(&tmp, &t->wheel[l][i]);
+	INIT_LIST_HEAD(&t->wheel[l][i]);
+	t->used[l] &= ~((uint64_t)1 << i);
+	list_for_each_safe(pos, next, &tmp)
+		ttl_place(t, container_of(pos, struct ttl_entry, node));
+}
+
+ttl_map *ttl_init(struct ttl_init *t_init)
+{
+	if(!t_init || !t_init->key_size || !t_init->cmp_func) {
+		hash_error("incorrect ttl_init structure");
+		return NULL;
+	}
+	ttl_map *t = (ttl_map *)malloc(sizeof(ttl_map));
+	struct hash_init h_init;
+	int l, i;
+
+	if(!t) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.type = HASH_CHAINED;
+	h_init.size = t_init->size;
+	h_init.key_size = t_init->key_size;
+	h_init.value_size = sizeof(struct ttl_entry) + t_init->value_size;
+	h_init.cmp_func = t_init->cmp_func;
+	h_init.hash_func = t_init->hash_func;
+	t->h = hash_init(&h_init);
+	t->scratch = t->h ? (unsigned char *)malloc(t->h->data_size) : NULL;
+	if(!t->scratch) {
+		hash_error("failed to allocate memory");
+		hash_free(t->h);
+		free(t);
+		return NULL;
+	}
+	for(l = 0; l < TTL_LEVELS; l++) {
+		for(i = 0; i < TTL_SLOTS; i++)
+			INIT_LIST_HEAD(&t->wheel[l][i]);
+		t->used[l] = 0;
+	}
+	t->cur = t_init->now;
+	t->key_size = t_init->key_size;
+	t->value_size = t_init->value_size;
+	t->on_expire = t_init->on_expire;
+	t->arg = t_init->arg;
+	return t;
+}
+
+bool ttl_get(ttl_map *t, const void *key, void *value, uint64_t now)
+{
+	void *data = hash_find(t->h, key);
+	struct ttl_entry *e;
+
+	if(!data) return false;
+	e = (struct ttl_entry *)hash_value(t->h, data);
+	if(e->expire <= now) {
+		ttl_drop(t, e);
+		return false;
+	}
+	if(value)
+		memcpy(value, e->value, t->value_size);
+	return true;
+}
+
+bool ttl_put(ttl_map *t, const void *key, const void *value,
+		uint64_t expire)
+{
+	bool inserted;
+	struct ttl_entry *e = (struct ttl_entry *)
+		hash_get_or_insert(t->h, key, &inserted);
+
+	if(!e) return false;
+	if(!inserted)
+		ttl_unlink(t, e);
+	e->expire = expire;
+	memcpy(e->value, value, t->value_size);
+	ttl_place(t, e);
+	return true;
+}
+
+bool ttl_delete(ttl_map *t, const void *key)
+{
+	void *data = hash_find(t->h, key);
+	if(!data) return false;
+	ttl_remove(t, (struct ttl_entry *)hash_value(t->h, data));
+	return true;
+}
+
+/* first k >= 1 such that bit (base + k) % TTL_SLOTS of used, */
+/* which is not zero, is set */
+static uint64_t next_used(uint64_t used, uint64_t base)
+{
+	unsigned int r = (unsigned int)((base + 1) & SLOT_MASK);
+	uint64_t rot = r ? used >> r | used << (TTL_SLOTS - r) : used;
+	return 1 + (uint64_t)__builtin_ctzll(rot);
+}
+
+/* the first tick after cur at which a slot is emptied or cascaded, */
+/* or UINT64_MAX if the wheel is empty */
+static uint64_t next_event(const ttl_map *t)
+{
+	uint64_t next = UINT64_MAX;
+	int l;
+
+	if(t->used[0])
+		next = t->cur + next_used(t->used[0], t->cur);
+	for(l = 1; l < TTL_LEVELS; l++) {
+		uint64_t base = t->cur >> (l * SLOT_BITS), tick;
+		if(!t->used[l])
+			continue;
+		tick = (base + next_used(t->used[l], base)) << (l * SLOT_BITS);
+		if(tick < next)
+			next = tick;
+	}
+	return next;
+}
+
+size_t ttl_expire(ttl_map *t, uint64_t now, size_t budget)
+{
+	size_t n = 0;
+
+	while(t->cur <= now) {
+		struct list_head *slot = &t->wheel[0][t->cur & SLOT_MASK];
+		uint64_t next;
+		int l;
+
+		while(!list_is_empty(slot)) {
+			if(budget && n == budget)
+				return n;
+			ttl_drop(t, container_of(list_head(slot),
+						struct ttl_entry, node));
+			n++;
+		}
+		/* skip the ticks with nothing to do */
+		next = next_event(t);
+		t->cur = next <= now ? next : now + 1;
+		for(l = 1; l < TTL_LEVELS; l++) {
+			if(t->cur & (((uint64_t)1 << (l * SLOT_BITS)) - 1))
+				break;
+			ttl_cascade(t, l, (t->cur >> (l * SLOT_BITS)) & SLOT_MASK);
+		}
+	}
+	return n;
+}
+
+size_t ttl_nmembs(const ttl_map *t)
+{
+	return t->h->nmembs;
+}
+
+void ttl_free(ttl_map *t)
+{
+	if(!t) return;
+	hash_free(t->h);
+	free(t->scratch);
+	free(t);
+}
@@ -0,0 +1,144 @@
+#include "ttl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NKEYS 10000
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+static uint64_t expire_at[NKEYS];
+static uint64_t clock_now;
+static size_t nexpired;
+static bool early;
+
+/* check that an entry is never dropped before its time */
+void on_expire(const void *key, void *value, void *arg)
+{
+	int k = *(const int *)key;
+	(void)arg;
+	if(*(long *)value != -k || expire_at[k] > clock_now)
+		early = true;
+	nexpired++;
+}
+
+int main(void)
+{
+	struct ttl_init t_init;
+	ttl_map *t;
+	long value;
+	int i;
+
+	memset(&t_init, 0, sizeof(t_init));
+	t_init.key_size = sizeof(int);
+	t_init.value_size = sizeof(long);
+	t_init.cmp_func = compare;
+	t_init.hash_func = hash_int;
+	t_init.now = 1000;
+	t_init.on_expire = on_expire;
+	t = ttl_init(&t_init);
+	if(!t) {
+		fprintf(stderr, "failed to initialize map\n");
+		goto FAILED;
+	}
+
+	/* ttls spread over every level, and past the top one */
+	srand(1);
+	clock_now = 1000;
+	for(i = 0; i < NKEYS; i++) {
+		value = -i;
+		switch(i % 4) {
+		case 0: expire_at[i] = clock_now + rand() % 64; break;
+		case 1: expire_at[i] = clock_now + rand() % 4096; break;
+		case 2: expire_at[i] = clock_now + rand() % (1 << 20); break;
+		default: expire_at[i] = clock_now + ((uint64_t)rand() << 8); break;
+		}
+		if(!ttl_put(t, &i, &value, expire_at[i])) {
+			fprintf(stderr, "put error\n");
+			goto FAILED;
+		}
+	}
+	/* refresh a few, and delete a few */
+	for(i = 0; i < NKEYS; i += 10) {
+		value = -i;
+		expire_at[i] += 100;
+		ttl_put(t, &i, &value, expire_at[i]);
+	}
+	for(i = 5; i < NKEYS; i += 10) {
+		if(!ttl_delete(t, &i)) {
+			fprintf(stderr, "delete error\n");
+			goto FAILED;
+		}
+		expire_at[i] = 0;
+	}
+	if(ttl_delete(t, &(int){5}) || ttl_nmembs(t) != NKEYS - NKEYS / 10) {
+		fprintf(stderr, "delete error\n");
+		goto FAILED;
+	}
+
+	/* lazy expiry on get */
+	for(i = 0; i < NKEYS; i++) {
+		if(expire_at[i] && expire_at[i] <= 1001) {
+			clock_now = 1001;
+			if(ttl_get(t, &i, &value, 1001)) {
+				fprintf(stderr, "get error\n");
+				goto FAILED;
+			}
+			expire_at[i] = 0;
+		} else if(expire_at[i] && (!ttl_get(t, &i, &value, 1001) ||
+					value != -i)) {
+			fprintf(stderr, "get error\n");
+			goto FAILED;
+		}
+	}
+
+	/* turn the wheel in steps of growing size: after each one, */
+	/* exactly the entries due are gone */
+	for(clock_now = 1001; clock_now < ((uint64_t)1 << 40);
+			clock_now += clock_now / 3) {
+		/* a small budget drops the due entries over several calls */
+		while(ttl_expire(t, clock_now, 7) == 7)
+			;
+		for(i = 0; i < NKEYS; i++) {
+			if(!expire_at[i])
+				continue;
+			if(ttl_get(t, &i, NULL, 0) != (expire_at[i] > clock_now)) {
+				fprintf(stderr, "expire error at %llu\n",
+						(unsigned long long)clock_now);
+				goto FAILED;
+			}
+		}
+	}
+	if(early || ttl_nmembs(t) != 0 || nexpired != NKEYS - NKEYS / 10) {
+		fprintf(stderr, "expire error\n");
+		goto FAILED;
+	}
+
+	/* time jumps straight over many slots */
+	value = 0;
+	i = 0;
+	expire_at[0] = clock_now + 100000;
+	ttl_put(t, &i, &value, expire_at[0]);
+	if(ttl_expire(t, clock_now + 99999, 0) != 0 ||
+			ttl_expire(t, clock_now + 100000, 0) != 1) {
+		fprintf(stderr, "expire error\n");
+		goto FAILED;
+	}
+	ttl_free(t);
+	printf("----------passed----------\n");
+	return 0;
+
+FAILED:
+	ttl_free(t);
+	printf("----------failed----------\n");
+	return 1;
+}
@@ -0,0 +1,223 @@
+#include "bloom.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ *    block: | word 0 | word 1 | ... | word 7 |   8 x 64 bits
+ *                ^        ^              ^
+ *                one bit per word, from the low half of the code
+ *
+ * Codes are first mixed with hash_mix64, so that a weak hash_func
+ * (such as the identity on small integers) still spreads over every
+ * block. The upper half of the mixed code selects the block; the
+ * lower half is
+ * multiplied by eight odd constants, and the top six bits of each
+ * product select the bit of one word. When built with AVX2 (e.g.
+ * -mavx2) the eight masks are made and tested in two 256-bit
+ * registers.
+ */
+
+#define BLOCK_WORDS 8
+#define BLOCK_BITS (BLOCK_WORDS * 64)
+#define CACHE_LINE 64
+/* bits per element beyond those of a classic filter, */
+/* making up for the uneven load of blocks */
+#define BLOOM_SLACK 1.3
+#define BLOOM_FP 0.01
+#define COUNTER_MAX 255
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct bloom {
+	uint64_t *blocks;
+	void *raw;
+	size_t nblocks;
+	/* one counter per bit for a counting filter, or NULL */
+	unsigned char *counters;
+};
+
+static const uint32_t salt[BLOCK_WORDS] = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+static uint64_t *block_of(const struct bloom *b, uint64_t code)
+{
+	size_t i = (size_t)(((code >> 32) * (uint64_t)b->nblocks) >> 32);
+	return b->blocks + i * BLOCK_WORDS;
+}
+
+/* bit index of word i */
+static unsigned int bit_of(uint64_t code, int i)
+{
+	return ((uint32_t)code * salt[i]) >> 26;
+}
+
+/* log2(x) for x >= 1, to about six digits, without libm */
+static double log2_of(double x)
+{
+	double r = 0, f = 1;
+	int i;
+
+	while(x >= 2) {
+		x /= 2;
+		r += 1;
+	}
+	/* x is in [1, 2): take bits of the fraction by squaring */
+	for(i = 0; i < 20; i++) {
+		x *= x;
+		f /= 2;
+		if(x >= 2) {
+			x /= 2;
+			r += f;
+		}
+	}
+	return r;
+}
+
+#ifdef __AVX2__
+/* masks of words 0-3 and 4-7 */
+static void make_masks(uint64_t code, __m256i *lo, __m256i *hi)
+{
+	__m256i bits = _mm256_srli_epi32(_mm256_mullo_epi32(
+				_mm256_set1_epi32((int)(uint32_t)code),
+				_mm256_loadu_si256((const __m256i *)salt)), 26);
+	__m256i one = _mm256_set1_epi64x(1);
+	*lo = _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(
+				_mm256_castsi256_si128(bits)));
+	*hi = _mm256_sllv_epi64(one, _mm256_cvtepu32_epi64(
+				_mm256_extracti128_si256(bits, 1)));
+}
+#endif
+
+struct bloom *bloom_init(size_t n, double fp, bool counting)
+{
+	struct bloom *b = (struct bloom *)malloc(sizeof(struct bloom));
+	double bits;
+
+	if(!b) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	if(!(fp > 0 && fp < 1))
+		fp = BLOOM_FP;
+	/* a classic filter needs log2(1/fp) / ln(2) bits per element */
+	bits = (double)(n ? n : 1) * log2_of(1 / fp) * 1.4427 * BLOOM_SLACK;
+	b->nblocks = (size_t)(bits / BLOCK_BITS) + 1;
+	b->raw = malloc(b->nblocks * CACHE_LINE + CACHE_LINE);
+	b->counters = counting ? (unsigned char *)
+		calloc(b->nblocks, BLOCK_BITS) : NULL;
+	if(!b->raw || (counting && !b->counters)) {
+		hash_error("failed to allocate memory");
+		free(b->raw);
+		free(b->counters);
+		free(b);
+		return NULL;
+	}
+	b->blocks = (uint64_t *)((unsigned char *)b->raw +
+			(CACHE_LINE - (uintptr_t)b->raw % CACHE_LINE) % CACHE_LINE);
+	memset(b->blocks, 0, b->nblocks * CACHE_LINE);
+	return b;
+}
+
+void bloom_add(struct bloom *b, uint64_t code)
+{
+	code = hash_mix64(code);
+	uint64_t *block = block_of(b, code);
+	int i;
+
+	if(b->counters) {
+		unsigned char *c = b->counters +
+			(size_t)(block - b->blocks) / BLOCK_WORDS * BLOCK_BITS;
+		for(i = 0; i < BLOCK_WORDS; i++) {
+			unsigned char *x = &c[i * 64 + bit_of(code, i)];
+			if(*x < COUNTER_MAX)
+				(*x)++;
+		}
+	}
+#ifdef __AVX2__
+	__m256i lo, hi;
+	make_masks(code, &lo, &hi);
+	_mm256_store_si256((__m256i *)block, _mm256_or_si256(lo,
+				_mm256_load_si256((const __m256i *)block)));
+	_mm256_store_si256((__m256i *)(block + 4), _mm256_or_si256(hi,
+				_mm256_load_si256((const __m256i *)(block + 4))));
+#else
+	for(i = 0; i < BLOCK_WORDS; i++)
+		block[i] |= (uint64_t)1 << bit_of(code, i);
+#endif
+}
+
+bool bloom_test(const struct bloom *b, uint64_t code)
+{
+	code = hash_mix64(code);
+	const uint64_t *block = block_of(b, code);
+#ifdef __AVX2__
+	__m256i lo, hi;
+	make_masks(code, &lo, &hi);
+	return _mm256_testc_si256(
+			_mm256_load_si256((const __m256i *)block), lo) &&
+		_mm256_testc_si256(
+			_mm256_load_si256((const __m256i *)(block + 4)), hi);
+#else
+	uint64_t missing = 0;
+	int i;
+	for(i = 0; i < BLOCK_WORDS; i++)
+		missing |= ~block[i] & ((uint64_t)1 << bit_of(code, i));
+	return missing == 0;
+#endif
+}
+
+bool bloom_remove(struct bloom *b, uint64_t code)
+{
+	if(!b->counters) return false;
+	code = hash_mix64(code);
+	uint64_t *block = block_of(b, code);
+	unsigned char *c = b->counters +
+		(size_t)(block - b->blocks) / BLOCK_WORDS * BLOCK_BITS;
+	int i;
+
+	for(i = 0; i < BLOCK_WORDS; i++) {
+		unsigned int bit = bit_of(code, i);
+		unsigned char *x = &c[i * 64 + bit];
+		/* a saturated counter no longer knows its count */
+		if(*x == 0 || *x == COUNTER_MAX)
+			continue;
+		if(--*x == 0)
+			block[i] &= ~((uint64_t)1 << bit);
+	}
+	return true;
+}
+
+bool bloom_counting(const struct bloom *b)
+{
+	return b->counters != NULL;
+}
+
+void bloom_clear(struct bloom *b)
+{
+	memset(b->blocks, 0, b->nblocks * CACHE_LINE);
+	if(b->counters)
+		memset(b->counters, 0, b->nblocks * BLOCK_BITS);
+}
+
+size_t bloom_bytes(const struct bloom *b)
+{
+	return sizeof(struct bloom) + b->nblocks * CACHE_LINE + CACHE_LINE +
+		(b->counters ? b->nblocks * BLOCK_BITS : 0);
+}
+
+void bloom_free(struct bloom *b)
+{
+	if(!b) return;
+	free(b->raw);
+	free(b->counters);
+	free(b);
+}
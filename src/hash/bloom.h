@@ -0,0 +1,42 @@
+/* bloom.h defines a blocked Bloom filter over 64-bit hash codes.
+ *
+ * The filter is an array of 64-byte blocks. A code picks one block,
+ * and sets or tests one bit in each of its eight 64-bit words, so a
+ * test reads a single cache line. Blocking costs a little accuracy
+ * against a classic Bloom filter of the same size, which bloom_init
+ * makes up with a few more bits per element.
+ *
+ * A counting filter keeps an 8-bit counter for every bit, so codes
+ * can be removed; a counter that reaches 255 stays there. A plain
+ * filter can only be cleared and filled again.
+ *
+ * A filter can be put in front of a hash table with hash_bloom (see
+ * hash.h), which keeps it up to date and lets searches for absent
+ * elements return without reaching the table.
+ */
+
+#ifndef _BLOOM_H
+#define _BLOOM_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+struct bloom;
+
+/* allocate a filter for n codes with false positive rate fp; */
+/* fp outside (0, 1) means the default of 1% */
+struct bloom *bloom_init(size_t n, double fp, bool counting);
+void bloom_add(struct bloom *b, uint64_t code);
+/* return false if code has certainly not been added */
+bool bloom_test(const struct bloom *b, uint64_t code);
+/* remove a code added before from a counting filter */
+/* return false if the filter is not counting */
+bool bloom_remove(struct bloom *b, uint64_t code);
+bool bloom_counting(const struct bloom *b);
+void bloom_clear(struct bloom *b);
+/* memory held by the filter */
+size_t bloom_bytes(const struct bloom *b);
+void bloom_free(struct bloom *b);
+
+#endif
@@ -0,0 +1,123 @@
+#include "bloom.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define MAXSIZE (1<<18)
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+/* a weak hash_func: the key itself */
+uint64_t identity(const void *data)
+{
+	return (uint64_t)*(const int *)data;
+}
+
+int main(void)
+{
+	struct bloom *b;
+	hash *h;
+	struct hash_init h_init;
+	uint64_t i;
+	size_t fp;
+	int key, type;
+
+	b = bloom_init(MAXSIZE, 0.01, true);
+	if(!b) {
+		fprintf(stderr, "failed to initialize bloom\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++)
+		bloom_add(b, hash_uint64(&i));
+	for(i = 0, fp = 0; i < 2 * MAXSIZE; i++) {
+		bool res = bloom_test(b, hash_uint64(&i));
+		if(i < MAXSIZE && !res) {
+			fprintf(stderr, "test error\n");
+			goto FAILED;
+		}
+		fp += i >= MAXSIZE && res;
+	}
+	if(fp > MAXSIZE / 50) {
+		fprintf(stderr, "false positive rate %g\n",
+				(double)fp / MAXSIZE);
+		goto FAILED;
+	}
+	/* remove even codes from the counting filter */
+	for(i = 0; i < MAXSIZE; i += 2)
+		bloom_remove(b, hash_uint64(&i));
+	for(i = 0, fp = 0; i < MAXSIZE; i++) {
+		bool res = bloom_test(b, hash_uint64(&i));
+		if(i % 2 && !res) {
+			fprintf(stderr, "remove error\n");
+			goto FAILED;
+		}
+		fp += i % 2 == 0 && res;
+	}
+	if(fp > MAXSIZE / 100) {
+		fprintf(stderr, "remove error\n");
+		goto FAILED;
+	}
+	bloom_free(b);
+
+	/* a filter in front of a table */
+	for(type = HASH_CHAINED; type <= HASH_SWISS; type++) {
+		memset(&h_init, 0, sizeof(h_init));
+		h_init.type = type;
+		h_init.data_size = sizeof(int);
+		h_init.cmp_func = compare;
+		h = hash_init(&h_init);
+		if(!h || !hash_bloom(h, MAXSIZE, 0.01, type == HASH_SWISS)) {
+			fprintf(stderr, "failed to initialize hash\n");
+			goto FAILED;
+		}
+		for(key = 0; key < MAXSIZE; key++)
+			hash_insert(h, &key);
+		for(key = 0; key < MAXSIZE; key += 2)
+			hash_delete(h, &key);
+		if(type == HASH_CHAINED)
+			hash_bloom_rebuild(h);
+		for(key = 0; key < 2 * MAXSIZE; key++) {
+			if((hash_search(h, &key) != NULL) !=
+					(key < MAXSIZE && key % 2)) {
+				fprintf(stderr, "search error\n");
+				goto FAILED;
+			}
+		}
+		hash_free(h);
+	}
+
+	/* small codes from a weak hash_func still spread over the filter */
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.data_size = sizeof(int);
+	h_init.cmp_func = compare;
+	h_init.hash_func = identity;
+	h = hash_init(&h_init);
+	if(!h || !hash_bloom(h, MAXSIZE, 0.01, false)) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	for(key = 0; key < MAXSIZE; key++)
+		hash_insert(h, &key);
+	for(key = MAXSIZE, fp = 0; key < 2 * MAXSIZE; key++)
+		fp += bloom_test(h->bloom, hash_code(h, &key));
+	if(fp > MAXSIZE / 50) {
+		fprintf(stderr, "false positive rate %g\n",
+				(double)fp / MAXSIZE);
+		goto FAILED;
+	}
+	hash_free(h);
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
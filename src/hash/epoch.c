@@ -0,0 +1,219 @@
+#define _POSIX_C_SOURCE 200809L
+#include "epoch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+/*
+ * A record's state is 0 while its thread is outside any critical
+ * section, and (epoch << 1) | 1 while inside, epoch being the global
+ * epoch it observed on entry. The global epoch only moves from g to
+ * g + 1 when every active record has observed g, so once it reaches
+ * g + 1 nothing retired at g - 1 or before can be reached by a
+ * reader. Retired entries wait in one of three lists by epoch.
+ */
+
+#define CACHE_LINE 64
+
+#define epoch_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct epoch_record {
+	uint64_t state;
+	struct epoch *owner;
+	bool in_use;
+	struct epoch_record *next;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct epoch {
+	/* read by every reader, written only on advance */
+	uint64_t global __attribute__((aligned(CACHE_LINE)));
+	/* everything below is owned by the holder of lock */
+	pthread_mutex_t lock __attribute__((aligned(CACHE_LINE)));
+	struct epoch_record *records;
+	struct epoch_entry *limbo[3];
+	uint64_t limbo_epoch[3];
+	size_t nretired;
+};
+
+static void free_entries(struct epoch_entry *x)
+{
+	while(x != NULL) {
+		struct epoch_entry *next = x->next;
+		x->free(x);
+		x = next;
+	}
+}
+
+struct epoch *epoch_init(void)
+{
+	struct epoch *e;
+	int i;
+
+	if(posix_memalign((void **)&e, CACHE_LINE, sizeof(struct epoch))) {
+		epoch_error("failed to allocate memory");
+		return NULL;
+	}
+	if(pthread_mutex_init(&e->lock, NULL)) {
+		epoch_error("failed to initialize lock");
+		free(e);
+		return NULL;
+	}
+	e->global = 0;
+	e->records = NULL;
+	for(i = 0; i < 3; i++) {
+		e->limbo[i] = NULL;
+		e->limbo_epoch[i] = 0;
+	}
+	e->nretired = 0;
+	return e;
+}
+
+struct epoch_record *epoch_register(struct epoch *e)
+{
+	if(!e) return NULL;
+	struct epoch_record *r;
+
+	pthread_mutex_lock(&e->lock);
+	/* reuse a record given back by an exited thread */
+	for(r = e->records; r != NULL; r = r->next) {
+		if(!r->in_use) {
+			r->in_use = true;
+			pthread_mutex_unlock(&e->lock);
+			return r;
+		}
+	}
+	if(posix_memalign((void **)&r, CACHE_LINE,
+				sizeof(struct epoch_record))) {
+		pthread_mutex_unlock(&e->lock);
+		epoch_error("failed to allocate memory");
+		return NULL;
+	}
+	r->state = 0;
+	r->owner = e;
+	r->in_use = true;
+	r->next = e->records;
+	e->records = r;
+	pthread_mutex_unlock(&e->lock);
+	return r;
+}
+
+void epoch_unregister(struct epoch *e, struct epoch_record *r)
+{
+	if(!e || !r) return;
+	pthread_mutex_lock(&e->lock);
+	__atomic_store_n(&r->state, 0, __ATOMIC_RELEASE);
+	r->in_use = false;
+	pthread_mutex_unlock(&e->lock);
+}
+
+void epoch_enter(struct epoch_record *r)
+{
+	uint64_t g = __atomic_load_n(&r->owner->global, __ATOMIC_RELAXED);
+	__atomic_store_n(&r->state, (g << 1) | 1, __ATOMIC_RELAXED);
+	/* order the announcement before any load of shared pointers;
+	 * pairs with the fence in advance_locked */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(struct epoch_record *r)
+{
+	__atomic_store_n(&r->state, 0, __ATOMIC_RELEASE);
+}
+
+/* advance the epoch if every active reader has observed it */
+static bool advance_locked(struct epoch *e)
+{
+	uint64_t g = e->global;
+	struct epoch_record *r;
+	size_t slot;
+
+	/* a reader that announces itself after this fence will see
+	 * every unlink done before it */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	for(r = e->records; r != NULL; r = r->next) {
+		uint64_t state = __atomic_load_n(&r->state, __ATOMIC_ACQUIRE);
+		if((state & 1) && (state >> 1) != g)
+			return false;
+	}
+	__atomic_store_n(&e->global, g + 1, __ATOMIC_RELEASE);
+	/* entries retired at g - 1 are now unreachable */
+	slot = (g + 2) % 3;
+	if(e->limbo[slot] && e->limbo_epoch[slot] + 1 <= g) {
+		free_entries(e->limbo[slot]);
+		e->limbo[slot] = NULL;
+	}
+	return true;
+}
+
+void epoch_retire(struct epoch *e, struct epoch_entry *entry)
+{
+	if(!e || !entry) return;
+	pthread_mutex_lock(&e->lock);
+	uint64_t g = e->global;
+	size_t slot = g % 3;
+	/* the list still holds entries retired at g - 3 or before */
+	if(e->limbo_epoch[slot] != g) {
+		free_entries(e->limbo[slot]);
+		e->limbo[slot] = NULL;
+		e->limbo_epoch[slot] = g;
+	}
+	entry->next = e->limbo[slot];
+	e->limbo[slot] = entry;
+	if(++e->nretired % EPOCH_ADVANCE_RATE == 0)
+		advance_locked(e);
+	pthread_mutex_unlock(&e->lock);
+}
+
+bool epoch_advance(struct epoch *e)
+{
+	if(!e) return false;
+	bool res;
+
+	pthread_mutex_lock(&e->lock);
+	res = advance_locked(e);
+	pthread_mutex_unlock(&e->lock);
+	return res;
+}
+
+void epoch_synchronize(struct epoch *e)
+{
+	if(!e) return;
+	int advanced = 0;
+	int i;
+
+	/* after two more advances everything retired so far is safe */
+	while(advanced < 2) {
+		if(epoch_advance(e))
+			advanced++;
+		else
+			sched_yield();
+	}
+	pthread_mutex_lock(&e->lock);
+	for(i = 0; i < 3; i++) {
+		if(e->limbo_epoch[i] + 2 <= e->global) {
+			free_entries(e->limbo[i]);
+			e->limbo[i] = NULL;
+		}
+	}
+	pthread_mutex_unlock(&e->lock);
+}
+
+void epoch_free(struct epoch *e)
+{
+	if(!e) return;
+	struct epoch_record *r = e->records;
+	int i;
+
+	for(i = 0; i < 3; i++)
+		free_entries(e->limbo[i]);
+	while(r != NULL) {
+		struct epoch_record *next = r->next;
+		free(r);
+		r = next;
+	}
+	pthread_mutex_destroy(&e->lock);
+	free(e);
+}
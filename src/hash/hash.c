@@ -1,7 +1,9 @@
 #include "hash.h"
+#include "bloom.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 
 /*
  *    +--+
@@ -23,25 +25,40 @@
  *    +--+
  *      ^
  *      table
+ *
+ * When the load factor leaves [min_load, max_load], a table of
+ * double (or half) size is allocated and the buckets of the old
+ * table are moved into it a few at a time by the following
+ * operations, so no single operation pays for a full rehash.
  */
 
-#ifndef MUL_FACTOR
-#define MUL_FACTOR 0.6180339887
-#endif
+/* 2^64 divided by the golden ratio */
+#define FIB_FACTOR 0x9e3779b97f4a7c15ULL
 
 #define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
 		__FILE__, __LINE__, __func__, E)
 
-static void free_node(hash_list *node);
-static hash_list *new_node(hash *h, const void *data);
+extern const struct hash_ops hash_swiss_ops;
+extern const struct hash_ops hash_robin_ops;
+extern const struct hash_ops hash_cuckoo_ops;
+extern const struct hash_ops hash_mapped_ops;
+
+static void free_node(hash *h, hash_list *node);
+static hash_list *new_node(hash *h, const void *data, size_t size,
+		uint64_t code);
 static void copy(void *des, const void *src, size_t size);
+static hash_slot *hash_bucket(hash *h, uint64_t code);
+static void hash_rehash_step(hash *h);
+static void hash_resize(hash *h, size_t size);
+static void free_slabs(hash *h);
+static bool new_slab(hash *h, size_t bytes);
+static bool chain_insert(hash *h, const void *data, uint64_t code);
 
-/* use multiplication method to hash key into some index */
-int hash_gen_index(hash *h, int key)
+/* use Fibonacci hashing to map code into one of size buckets, */
+/* size being a power of two no less than 2 */
+static size_t hash_gen_index(size_t size, uint64_t code)
 {
-	double f = MUL_FACTOR * (double)key;
-	f -= (double)((int)f);
-	return (int)((double)h->size * f);
+	return (size_t)((code * FIB_FACTOR) >> (64 - __builtin_ctzll(size)));
 }
 
 /* allocate and initialize a hash structure */
@@ -52,22 +69,84 @@ hash *hash_init(struct hash_init *h_init)
 		hash_error("incorrect hash_init structure");
 		return NULL;
 	}
+	const struct hash_ops *ops;
+	switch(h_init->type) {
+	case HASH_CHAINED:
+		ops = NULL;
+		break;
+	case HASH_SWISS:
+		ops = &hash_swiss_ops;
+		break;
+	case HASH_ROBIN:
+		ops = &hash_robin_ops;
+		break;
+	case HASH_CUCKOO:
+		ops = &hash_cuckoo_ops;
+		break;
+	case HASH_MAPPED:
+		ops = &hash_mapped_ops;
+		break;
+	default:
+		hash_error("unknown hash type");
+		return NULL;
+	}
+	size_t size = 2;
+	while(size < (h_init->size ? h_init->size : HASH_INIT_SIZE))
+		size *= 2;
 	hash *h = (hash *)malloc(sizeof(hash));
-	hash_slot *table = (hash_slot *)
-		malloc(h_init->size * sizeof(hash_slot));
-	if(!h || !table) {
+	hash_slot *table = ops ? NULL :
+		(hash_slot *)calloc(size, sizeof(hash_slot));
+	if(!h || (!ops && !table)) {
 		hash_error("failed to allocate memory");
 		free(h);
 		free(table);
 		return NULL;
 	}
-	memset(table, 0, HASH_INIT_SIZE * sizeof(hash_slot));
 	h->hash = h_init->hash_func;
 	h->compare = h_init->cmp_func;
 	h->data_size = h_init->data_size;
-	h->size = h_init->size;
+	h->key_size = h_init->key_size;
+	h->value_offset = 0;
+	h->value_size = 0;
+	if(h->key_size) {
+		size_t align = 1;
+		while(align < h_init->value_size && align < 8)
+			align *= 2;
+		h->value_offset = (h->key_size + align - 1) / align * align;
+		h->value_size = h_init->value_size;
+		h->data_size = (h->value_offset + h->value_size + align - 1) /
+			align * align;
+	}
+	h->size = size;
 	h->nmembs = 0;
 	h->table = table;
+	h->old_table = NULL;
+	h->old_size = 0;
+	h->rehash_idx = 0;
+	h->init_size = size;
+	h->max_load = h_init->max_load > 0 ? h_init->max_load : HASH_MAX_LOAD;
+	h->min_load = h_init->min_load < h->max_load / 4 ?
+		h_init->min_load : h->max_load / 4;
+	h->rehash_step = h_init->rehash_step ?
+		h_init->rehash_step : HASH_REHASH_STEP;
+	/* keep inline data aligned as malloc would */
+	h->node_size = (sizeof(hash_list) + h->data_size + 7) & ~(size_t)7;
+	h->slabs = NULL;
+	h->slab_pos = NULL;
+	h->slab_left = 0;
+	h->free_nodes = NULL;
+	memset(&h->counters, 0, sizeof(h->counters));
+	h->bloom = NULL;
+	h->ops = ops;
+	h->engine = NULL;
+	if(ops && !ops->init(h, h_init)) {
+		hash_error("failed to initialize hash engine");
+		free(h);
+		return NULL;
+	}
+	/* a HASH_MAPPED table learns data_size from its file */
+	if(!h->key_size)
+		h->key_size = h->data_size;
 	return h;
 }
 
@@ -77,63 +156,299 @@ hash *hash_init(struct hash_init *h_init)
 bool hash_insert(hash *h, const void *data)
 {
 	if(!h) return false;
-	int integer = h->hash(data);
-	if(integer < 0) {
-		hash_error("error in genarating index");
-		return false;
-	}
-	int index = hash_gen_index(h, integer);
-	hash_list *node = new_node(h, data);
-	if(!node) {
-		hash_error("make new node failed");
-		return false;
+	if(h->ops) {
+		size_t nmembs = h->nmembs;
+		bool res = h->ops->insert(h, data);
+		if(h->bloom && h->nmembs > nmembs)
+			bloom_add(h->bloom, hash_code(h, data));
+		return res;
 	}
-	/* tranverse the list to find data; */
-	/* and if found, delete it */
-	hash_list *x = h->table[index].next;
-	hash_list **prev = &h->table[index].next;
+	return chain_insert(h, data, hash_code(h, data));
+}
+
+/* find data of given hash code in a chained table, or add a node */
+/* holding its first size bytes; return the node, or NULL if failed */
+static hash_list *chain_get(hash *h, const void *data, size_t size,
+		uint64_t code, bool *inserted)
+{
+	hash_rehash_step(h);
+	hash_slot *slot = hash_bucket(h, code);
+
+	/* tranverse the list to find data */
+	hash_list *x = slot->next;
+	HASH_STAT(size_t probes = 0);
 	while(x != NULL) {
-		if(h->compare(x->data, data) == 0) {
-			*prev = x->next;
-			free_node(x);
+		HASH_STAT(probes++);
+		if(x->code == code && hash_cmp(h, x->data, data) == 0)
 			break;
-		}
-		prev = &x->next;
 		x = x->next;
 	}
+	HASH_STAT(hash_count_lookup(h, x != NULL, probes));
+	*inserted = x == NULL;
+	if(x)
+		return x;
+	x = new_node(h, data, size, code);
+	if(!x) {
+		hash_error("make new node failed");
+		return NULL;
+	}
 	/* add data to the head of list */
-	node->next = h->table[index].next;
-	h->table[index].next = node;
+	x->next = slot->next;
+	slot->next = x;
 	h->nmembs++;
+	if(h->bloom)
+		bloom_add(h->bloom, code);
+	/* resizing relinks nodes without moving them */
+	if(!h->old_table && h->nmembs > h->max_load * h->size)
+		hash_resize(h, h->size * 2);
+	return x;
+}
+
+/* insert data of given hash code into a chained table, */
+/* replacing an equal element in place */
+bool chain_insert(hash *h, const void *data, uint64_t code)
+{
+	bool inserted;
+	hash_list *x = chain_get(h, data, h->data_size, code, &inserted);
+	if(!x)
+		return false;
+	if(!inserted)
+		copy(x->data, data, h->data_size);
+	return true;
+}
+
+/* build a chained table from n elements */
+static bool chain_build(hash *h, const unsigned char *p, size_t n)
+{
+	size_t size = h->size, i, b;
+	bool res = false;
+
+	while(n > h->max_load * size)
+		size *= 2;
+	uint64_t *codes = (uint64_t *)malloc(n * sizeof(uint64_t));
+	size_t *end = (size_t *)calloc(size + 1, sizeof(size_t));
+	size_t *order = (size_t *)malloc(n * sizeof(size_t));
+	hash_slot *table = size == h->size ? h->table :
+		(hash_slot *)calloc(size, sizeof(hash_slot));
+	if(!codes || !end || !order || !table ||
+			!new_slab(h, n * h->node_size)) {
+		hash_error("failed to allocate memory");
+		if(table != h->table)
+			free(table);
+		goto OUT;
+	}
+	if(table != h->table) {
+		free(h->table);
+		h->table = table;
+		h->size = size;
+	}
+
+	/* counting sort of the input by bucket, keeping input order */
+	/* within a bucket so that later duplicates win */
+	for(i = 0; i < n; i++) {
+		codes[i] = hash_code(h, p + i * h->data_size);
+		end[hash_gen_index(size, codes[i]) + 1]++;
+	}
+	for(b = 0; b < size; b++)
+		end[b + 1] += end[b];
+	for(i = 0; i < n; i++)
+		order[end[hash_gen_index(size, codes[i])]++] = i;
+
+	/* end[b] is now where bucket b ends; the nodes of a chain */
+	/* are carved one after another from the slab */
+	for(b = 0, i = 0; b < size; b++) {
+		hash_list **tail = &table[b].next;
+		for(; i < end[b]; i++) {
+			const void *data = p + order[i] * h->data_size;
+			uint64_t code = codes[order[i]];
+			hash_list *x;
+			for(x = table[b].next; x != NULL; x = x->next)
+				if(x->code == code &&
+						hash_cmp(h, x->data, data) == 0)
+					break;
+			if(x) {
+				copy(x->data, data, h->data_size);
+				continue;
+			}
+			*tail = new_node(h, data, h->data_size, code);
+			tail = &(*tail)->next;
+			h->nmembs++;
+		}
+	}
+	res = true;
+OUT:
+	free(codes);
+	free(end);
+	free(order);
+	return res;
+}
+
+/* add an element of key and a zeroed value to a table without */
+/* get_or_insert, then search it again */
+static void *generic_get_or_insert(hash *h, const void *key, bool *inserted)
+{
+	void *data = h->ops->search(h, key);
+	unsigned char *tmp;
+
+	*inserted = data == NULL;
+	if(data)
+		return data;
+	tmp = (unsigned char *)calloc(1, h->data_size);
+	if(!tmp) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	copy(tmp, key, h->key_size);
+	if(h->ops->insert(h, tmp))
+		data = h->ops->search(h, key);
+	free(tmp);
+	return data;
+}
+
+/* return a pointer to the value of key in a map, adding key */
+/* with a zeroed value if absent */
+/* return NULL if failed */
+void *hash_get_or_insert(hash *h, const void *key, bool *inserted)
+{
+	bool dummy;
+	void *data;
+
+	if(!h || !key) return NULL;
+	if(!inserted)
+		inserted = &dummy;
+	if(!h->ops) {
+		hash_list *x = chain_get(h, key, h->key_size,
+				hash_code(h, key), inserted);
+		data = x ? x->data : NULL;
+	} else {
+		data = h->ops->get_or_insert ?
+			h->ops->get_or_insert(h, key, inserted) :
+			generic_get_or_insert(h, key, inserted);
+		if(data && *inserted && h->bloom)
+			bloom_add(h->bloom, hash_code(h, key));
+	}
+	return data ? hash_value(h, data) : NULL;
+}
+
+/* set the value of key in a map, adding key if absent */
+bool hash_upsert(hash *h, const void *key, const void *value)
+{
+	void *v = hash_get_or_insert(h, key, NULL);
+	if(!v) return false;
+	copy(v, value, h->value_size);
 	return true;
 }
 
+/* call fn on the value of key in a map, adding key first if absent */
+/* return the value, or NULL if failed */
+void *hash_update(hash *h, const void *key,
+		void (*fn)(void *value, bool inserted, void *arg), void *arg)
+{
+	bool inserted;
+	void *v = hash_get_or_insert(h, key, &inserted);
+	if(v && fn)
+		fn(v, inserted, arg);
+	return v;
+}
+
+/* build a table from n elements stored one after another at data, */
+/* as if each were inserted in turn */
+/* return a pointer to the new table, or NULL if failed */
+hash *hash_build(struct hash_init *h_init, const void *data, size_t n)
+{
+	hash *h = hash_init(h_init);
+	const unsigned char *p = (const unsigned char *)data;
+	size_t i;
+
+	if(!h || n == 0) return h;
+	if(h->ops) {
+		for(i = 0; i < n; i++) {
+			if(!h->ops->insert(h, p + i * h->data_size)) {
+				hash_free(h);
+				return NULL;
+			}
+		}
+		return h;
+	}
+	if(!chain_build(h, p, n)) {
+		hash_free(h);
+		return NULL;
+	}
+	return h;
+}
+
+/* return the element after the cursor and advance it, */
+/* or return NULL at the end */
+void *hash_next(hash *h, struct hash_iter *it)
+{
+	if(!h || !it) return NULL;
+	if(h->ops)
+		return h->ops->next ? h->ops->next(h, it) : NULL;
+	/* pos counts the buckets of the table, then of the old table */
+	hash_list *x = (hash_list *)it->node;
+	while(x == NULL) {
+		if(it->pos >= h->size + h->old_size)
+			return NULL;
+		x = it->pos < h->size ? h->table[it->pos].next :
+			h->old_table[it->pos - h->size].next;
+		it->pos++;
+	}
+	it->node = x->next;
+	return x->data;
+}
+
+/* call fn on every element, in the order of hash_next */
+void hash_foreach(hash *h, void (*fn)(void *data, void *arg), void *arg)
+{
+	struct hash_iter it = { 0, NULL };
+	void *data;
+
+	if(!h || !fn) return;
+	while((data = hash_next(h, &it)) != NULL)
+		fn(data, arg);
+}
+
 /* delete data from hash table */
 /* return true if delete successfully */
 /* return false if errors happen */
 bool hash_delete(hash *h, void *data)
 {
 	if(!h) return false;
-	int integer = h->hash(data);
-	if(integer < 0) {
-		hash_error("error in genarating index");
-		return false;
+	if(h->ops) {
+		bool res = h->ops->delete(h, data);
+		if(res && h->bloom && bloom_counting(h->bloom))
+			bloom_remove(h->bloom, hash_code(h, data));
+		return res;
 	}
-	int index = hash_gen_index(h, integer);
+	uint64_t code = hash_code(h, data);
+	hash_rehash_step(h);
+	hash_slot *slot = hash_bucket(h, code);
 
 	/* tranverse the list to find and delete data */
-	hash_list *x = h->table[index].next;
-	hash_list **prev = &h->table[index].next;
+	hash_list *x = slot->next;
+	hash_list **prev = &slot->next;
+	HASH_STAT(size_t probes = 0);
 	while(x != NULL) {
-		if(h->compare(x->data, data) == 0) {
+		HASH_STAT(probes++);
+		if(x->code == code && hash_cmp(h, x->data, data) == 0) {
+			HASH_STAT(hash_count_lookup(h, true, probes));
 			*prev = x->next;
-			copy(data, x, h->data_size);
-			free_node(x);
+			copy(data, x->data, h->data_size);
+			free_node(h, x);
+			h->nmembs--;
+			if(h->bloom && bloom_counting(h->bloom))
+				bloom_remove(h->bloom, code);
+			/* halve at most once per delete, so that the rehash */
+			/* stays incremental; later deletes shrink it further */
+			if(!h->old_table && h->size / 2 >= h->init_size &&
+					h->nmembs < h->min_load * h->size)
+				hash_resize(h, h->size / 2);
 			return true;
 		}
 		prev = &x->next;
 		x = x->next;
 	}
+	HASH_STAT(hash_count_lookup(h, false, probes));
 	return false;
 }
 
@@ -143,62 +458,415 @@ bool hash_delete(hash *h, void *data)
 void *hash_search(hash *h, const void *data)
 {
 	if(!h) return NULL;
-	int integer = h->hash(data);
-	if(integer < 0) {
-		hash_error("error in genarating index");
-		return false;
+	if(!h->ops)
+		hash_rehash_step(h);
+	return hash_find(h, data);
+}
+
+/* search data without moving buckets of an ongoing resize */
+void *hash_find(hash *h, const void *data)
+{
+	if(!h) return NULL;
+	if(h->ops) {
+		if(h->bloom && !bloom_test(h->bloom, hash_code(h, data))) {
+			HASH_STAT(hash_count_lookup(h, false, 0));
+			return NULL;
+		}
+		return h->ops->search(h, data);
+	}
+	uint64_t code = hash_code(h, data);
+	if(h->bloom && !bloom_test(h->bloom, code)) {
+		HASH_STAT(hash_count_lookup(h, false, 0));
+		return NULL;
 	}
-	int index = hash_gen_index(h, integer);
+	hash_slot *slot = hash_bucket(h, code);
 
 	/* tranverse the list to find data */
-	hash_list *x = h->table[index].next;
+	hash_list *x = slot->next;
+	HASH_STAT(size_t probes = 0);
 	while(x != NULL) {
-		if(h->compare(x->data, data) == 0)
-			return x->data;
+		HASH_STAT(probes++);
+		if(x->code == code && hash_cmp(h, x->data, data) == 0)
+			break;
 		x = x->next;
 	}
-	return NULL;
+	HASH_STAT(hash_count_lookup(h, x != NULL, probes));
+	return x ? x->data : NULL;
+}
+
+/* search n elements stored one after another at data, */
+/* setting results[i] as hash_search would for the i-th one */
+/* return the number of elements found */
+size_t hash_search_batch(hash *h, const void *data, size_t n, void **results)
+{
+	if(!h || !results) return 0;
+	const unsigned char *p = (const unsigned char *)data;
+	size_t i, j, found = 0;
+
+	if(h->ops) {
+		for(i = 0; i < n; i++) {
+			results[i] = hash_find(h, p + i * h->data_size);
+			found += results[i] != NULL;
+		}
+		return found;
+	}
+	hash_rehash_step(h);
+	/* group prefetching: each stage issues the loads of a whole
+	 * group before the next stage depends on any of them */
+	for(i = 0; i < n; i += HASH_BATCH) {
+		size_t m = n - i < HASH_BATCH ? n - i : HASH_BATCH;
+		uint64_t codes[HASH_BATCH];
+		hash_slot *slots[HASH_BATCH];
+		hash_list *nodes[HASH_BATCH];
+
+		for(j = 0; j < m; j++) {
+			codes[j] = hash_code(h, p + (i + j) * h->data_size);
+			/* data the filter rejects is left with no bucket */
+			if(h->bloom && !bloom_test(h->bloom, codes[j])) {
+				slots[j] = NULL;
+				continue;
+			}
+			slots[j] = hash_bucket(h, codes[j]);
+			__builtin_prefetch(slots[j]);
+		}
+		for(j = 0; j < m; j++) {
+			nodes[j] = slots[j] ? slots[j]->next : NULL;
+			if(nodes[j])
+				__builtin_prefetch(nodes[j]);
+		}
+		for(j = 0; j < m; j++) {
+			const void *key = p + (i + j) * h->data_size;
+			hash_list *x = nodes[j];
+			HASH_STAT(size_t probes = 0);
+			while(x != NULL) {
+				HASH_STAT(probes++);
+				if(x->code == codes[j] &&
+						hash_cmp(h, x->data, key) == 0)
+					break;
+				x = x->next;
+			}
+			HASH_STAT(hash_count_lookup(h, x != NULL, probes));
+			results[i + j] = x ? x->data : NULL;
+			found += x != NULL;
+		}
+	}
+	return found;
+}
+
+/* insert n elements stored one after another at data */
+/* return the number of elements inserted */
+size_t hash_insert_batch(hash *h, const void *data, size_t n)
+{
+	if(!h) return 0;
+	const unsigned char *p = (const unsigned char *)data;
+	size_t i, j, inserted = 0;
+
+	if(h->ops) {
+		for(i = 0; i < n; i++)
+			inserted += hash_insert(h, p + i * h->data_size);
+		return inserted;
+	}
+	for(i = 0; i < n; i += HASH_BATCH) {
+		size_t m = n - i < HASH_BATCH ? n - i : HASH_BATCH;
+		uint64_t codes[HASH_BATCH];
+
+		for(j = 0; j < m; j++) {
+			codes[j] = hash_code(h, p + (i + j) * h->data_size);
+			__builtin_prefetch(hash_bucket(h, codes[j]));
+		}
+		for(j = 0; j < m; j++)
+			inserted += chain_insert(h,
+					p + (i + j) * h->data_size, codes[j]);
+	}
+	return inserted;
 }
 
 void hash_free(hash *h)
 {
 	if(!h) return;
-	int i;
+	if(h->ops)
+		h->ops->free(h);
+	bloom_free(h->bloom);
+	free_slabs(h);
+	free(h->table);
+	free(h->old_table);
+	free(h);
+}
+
+/* put a Bloom filter in front of h, filled with its elements */
+bool hash_bloom(hash *h, size_t n, double fp, bool counting)
+{
+	if(!h) return false;
+	struct bloom *b = bloom_init(n ? n : h->nmembs, fp, counting);
+	if(!b) return false;
+	bloom_free(h->bloom);
+	h->bloom = b;
+	return hash_bloom_rebuild(h);
+}
 
+/* clear the filter of h and fill it again with the elements of h */
+bool hash_bloom_rebuild(hash *h)
+{
+	struct hash_iter it = { 0, NULL };
+	void *data;
+
+	if(!h || !h->bloom) return false;
+	bloom_clear(h->bloom);
+	while((data = hash_next(h, &it)) != NULL)
+		bloom_add(h->bloom, hash_code(h, data));
+	return true;
+}
+
+/* finish any resize, fit the size to nmembs, and move all nodes */
+/* to one block in bucket order */
+bool hash_compact(hash *h)
+{
+	if(!h) return false;
+	if(h->ops) return true;
+	while(h->old_table)
+		hash_rehash_step(h);
+
+	/* the size a table shrinking at min_load ends up with, */
+	/* but never past max_load */
+	size_t size = h->init_size, n = h->nmembs, i, b;
+	while(n > h->max_load * size ||
+			(h->min_load == 0 && size < h->size))
+		size *= 2;
+	hash_slot *table = (hash_slot *)calloc(size, sizeof(hash_slot));
+	size_t *end = (size_t *)calloc(size + 1, sizeof(size_t));
+	struct hash_slab *slabs = h->slabs;
+	unsigned char *slab_pos = h->slab_pos, *base;
+	size_t slab_left = h->slab_left;
+
+	h->slabs = NULL;
+	if(!table || !end || !new_slab(h, n * h->node_size)) {
+		hash_error("failed to allocate memory");
+		free(table);
+		free(end);
+		h->slabs = slabs;
+		h->slab_pos = slab_pos;
+		h->slab_left = slab_left;
+		return false;
+	}
+	base = h->slab_pos;
+	h->slab_pos += n * h->node_size;
+	h->slab_left -= n * h->node_size;
+
+	/* counting sort of the nodes by their new bucket */
 	for(i = 0; i < h->size; i++) {
-		hash_list *x = h->table[i].next;
-		while(x != NULL) {
-			hash_list *tmp = x;
-			x = x->next;
-			free_node(tmp);
+		hash_list *x;
+		for(x = h->table[i].next; x != NULL; x = x->next)
+			end[hash_gen_index(size, x->code) + 1]++;
+	}
+	for(b = 0; b < size; b++)
+		end[b + 1] += end[b];
+	for(i = 0; i < h->size; i++) {
+		hash_list *x;
+		for(x = h->table[i].next; x != NULL; x = x->next) {
+			b = hash_gen_index(size, x->code);
+			copy(base + end[b]++ * h->node_size, x, h->node_size);
 		}
 	}
+	/* end[b] is now where bucket b ends; link each run of nodes */
+	for(b = 0, i = 0; b < size; b++) {
+		hash_list **tail = &table[b].next;
+		for(; i < end[b]; i++) {
+			*tail = (hash_list *)(base + i * h->node_size);
+			tail = &(*tail)->next;
+		}
+		*tail = NULL;
+	}
+	free(end);
+
+	/* drop the old nodes, free list included */
+	h->free_nodes = NULL;
+	while(slabs != NULL) {
+		struct hash_slab *tmp = slabs;
+		slabs = slabs->next;
+		free(tmp);
+	}
 	free(h->table);
-	free(h);
+	h->table = table;
+	h->size = size;
+	return true;
+}
+
+/* add chain lengths of table to st */
+static void chain_hist(hash_slot *table, size_t size, struct hash_stats *st)
+{
+	size_t i;
+
+	for(i = 0; i < size; i++) {
+		size_t n = 0;
+		hash_list *x;
+		for(x = table[i].next; x != NULL; x = x->next)
+			n++;
+		if(n > st->max_chain)
+			st->max_chain = n;
+		st->hist[n < HASH_HIST_SIZE ? n : HASH_HIST_SIZE - 1]++;
+	}
+}
+
+/* fill st with the shape of the table and its counters */
+/* return false if h is NULL */
+bool hash_stats(hash *h, struct hash_stats *st)
+{
+	if(!h || !st) return false;
+	memset(st, 0, sizeof(struct hash_stats));
+	st->nmembs = h->nmembs;
+	st->size = h->size;
+	st->load = h->size ? (double)h->nmembs / h->size : 0;
+	st->bytes = sizeof(hash);
+	if(h->ops) {
+		if(h->ops->stats)
+			h->ops->stats(h, st);
+	} else {
+		struct hash_slab *x;
+		/* buckets of both tables while a resize is under way, */
+		/* but not the old ones already migrated */
+		chain_hist(h->table, h->size, st);
+		if(h->old_table)
+			chain_hist(h->old_table + h->rehash_idx,
+					h->old_size - h->rehash_idx, st);
+		st->bytes += (h->size + h->old_size) * sizeof(hash_slot);
+		for(x = h->slabs; x != NULL; x = x->next)
+			st->bytes += x->size;
+	}
+	if(h->bloom)
+		st->bytes += bloom_bytes(h->bloom);
+	st->counters = h->counters;
+	if(h->counters.hits)
+		st->probes_per_hit =
+			(double)h->counters.hit_probes / h->counters.hits;
+	if(h->counters.misses)
+		st->probes_per_miss =
+			(double)h->counters.miss_probes / h->counters.misses;
+	return true;
+}
+
+/* return the bucket in which key lives: buckets of the old table
+ * that have been migrated are found in the new one */
+hash_slot *hash_bucket(hash *h, uint64_t code)
+{
+	if(h->old_table) {
+		size_t index = hash_gen_index(h->old_size, code);
+		if(index >= h->rehash_idx)
+			return &h->old_table[index];
+	}
+	return &h->table[hash_gen_index(h->size, code)];
+}
+
+/* start moving all nodes into a new table of given size */
+void hash_resize(hash *h, size_t size)
+{
+	hash_slot *table = (hash_slot *)calloc(size, sizeof(hash_slot));
+	/* keep working with the current table if allocation failed */
+	if(!table) return;
+	h->old_table = h->table;
+	h->old_size = h->size;
+	h->rehash_idx = 0;
+	h->table = table;
+	h->size = size;
+}
+
+/* migrate at most rehash_step non-empty buckets of the old table,
+ * skipping no more than 10 empty buckets for each of them */
+void hash_rehash_step(hash *h)
+{
+	if(!h->old_table) return;
+	size_t n = h->rehash_step;
+	size_t empty = n * 10;
+
+	while(n > 0 && h->rehash_idx < h->old_size) {
+		hash_list *x = h->old_table[h->rehash_idx].next;
+		if(x == NULL) {
+			h->rehash_idx++;
+			if(--empty == 0)
+				break;
+			continue;
+		}
+		n--;
+		while(x != NULL) {
+			hash_list *next = x->next;
+			hash_slot *slot = &h->table[
+				hash_gen_index(h->size, x->code)];
+			x->next = slot->next;
+			slot->next = x;
+			x = next;
+		}
+		h->old_table[h->rehash_idx++].next = NULL;
+	}
+	if(h->rehash_idx == h->old_size) {
+		free(h->old_table);
+		h->old_table = NULL;
+		h->old_size = 0;
+		h->rehash_idx = 0;
+	}
+}
+
+/* release all slabs, and with them every node */
+void free_slabs(hash *h)
+{
+	struct hash_slab *x = h->slabs;
+
+	while(x != NULL) {
+		struct hash_slab *tmp = x;
+		x = x->next;
+		free(tmp);
+	}
+	h->slabs = NULL;
+	h->slab_left = 0;
+	h->free_nodes = NULL;
 }
 
-hash_list *new_node(hash *h, const void *data)
+/* start a new slab with room for at least bytes of nodes */
+bool new_slab(hash *h, size_t bytes)
 {
-	hash_list *node = (hash_list *)
-		malloc(sizeof(hash_list));
-	void *node_data = malloc(h->data_size);
-	if(!node || !node_data) {
+	size_t size = sizeof(struct hash_slab) + 7 +
+		(bytes > HASH_SLAB_SIZE ? bytes : HASH_SLAB_SIZE);
+	struct hash_slab *slab = (struct hash_slab *)malloc(size);
+	if(!slab) {
 		hash_error("failed to allocate memory");
-		free(node);
-		free(node_data);
-		return NULL;
+		return false;
+	}
+	slab->next = h->slabs;
+	slab->size = size;
+	h->slabs = slab;
+	/* node_size is a multiple of 8; align the first node */
+	h->slab_pos = (unsigned char *)(slab + 1);
+	h->slab_pos += (8 - (uintptr_t)h->slab_pos % 8) % 8;
+	h->slab_left = size - (h->slab_pos - (unsigned char *)slab);
+	return true;
+}
+
+/* take a node from the free list, or carve one from the current slab */
+/* the first size bytes of data are copied, the rest zeroed */
+hash_list *new_node(hash *h, const void *data, size_t size, uint64_t code)
+{
+	hash_list *node = h->free_nodes;
+
+	if(node) {
+		h->free_nodes = node->next;
+	} else {
+		if(h->slab_left < h->node_size && !new_slab(h, h->node_size))
+			return NULL;
+		node = (hash_list *)h->slab_pos;
+		h->slab_pos += h->node_size;
+		h->slab_left -= h->node_size;
 	}
-	copy(node_data, data, h->data_size);
-	node->data = node_data;
+	copy(node->data, data, size);
+	memset(node->data + size, 0, h->data_size - size);
+	node->code = code;
 	node->next = NULL;
 
 	return node;
 }
 
-void free_node(hash_list *node)
+/* put node on the free list for reuse */
+void free_node(hash *h, hash_list *node)
 {
-	free(node->data);
-	free(node);
+	node->next = h->free_nodes;
+	h->free_nodes = node;
 }
 
 void copy(void *des, const void *src, size_t size)
@@ -2,38 +2,236 @@
 #define _HASH_H
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <stdbool.h>
 
 #define HASH_INIT_SIZE (1<<12)
+#define HASH_SLAB_SIZE (1<<16)
+/* number of lookups overlapped by hash_search_batch */
+#define HASH_BATCH (16)
+/* grow when nmembs exceeds HASH_MAX_LOAD * size */
+#define HASH_MAX_LOAD (1.0)
+/* default max_load of HASH_ROBIN tables */
+#define HASH_ROBIN_MAX_LOAD (0.9)
+/* buckets migrated by each operation during a resize */
+#define HASH_REHASH_STEP (1)
 
-typedef int (*hash_func)(const void *);
+enum hash_type {
+	/* separate chaining, resized incrementally */
+	HASH_CHAINED,
+	/* open addressing over a flat slot array, probed 16 control
+	 * bytes at a time; the load factor is fixed at 7/8 */
+	HASH_SWISS,
+	/* open addressing with linear probing, Robin Hood insertion
+	 * and backward-shift deletion; max_load defaults to
+	 * HASH_ROBIN_MAX_LOAD and must be below 1 */
+	HASH_ROBIN,
+	/* bucketized cuckoo hashing: 4 slots in each of two buckets,
+	 * plus a small stash; max_load defaults to 0.95 */
+	HASH_CUCKOO,
+	/* read-only table mapped from a file written by hash_save */
+	HASH_MAPPED
+};
+
+typedef uint64_t (*hash_func)(const void *);
 typedef int (*cmp_func)(const void *, const void *);
 
+/* data of data_size bytes is stored inline after the node */
 typedef struct hash_list {
 	struct hash_list *next;
-	void *data;
+	/* hash code of data, compared before calling cmp_func
+	 * and reused when the node moves to another table */
+	uint64_t code;
+	unsigned char data[];
 } hash_list;
 
+/* nodes are carved from slabs of HASH_SLAB_SIZE bytes */
+struct hash_slab {
+	struct hash_slab *next;
+	size_t size;
+};
+
 typedef struct hash_slot {
 	hash_list *next;
 } hash_slot;
 
+struct hash_ops;
+struct bloom;
+
+/* operation counters, updated only by a library built with */
+/* -DHASH_STATS, e.g. make CFLAGS="-std=c99 -O2 -DHASH_STATS"; */
+/* counting makes every search write to the table. A lookup is */
+/* the search for equal data done by any operation, and a probe is */
+/* one node (chained tables), group, slot or bucket (open */
+/* addressing engines) examined */
+struct hash_counters {
+	size_t hits;
+	size_t misses;
+	size_t hit_probes;
+	size_t miss_probes;
+	size_t compares;
+};
+
 typedef struct {
 	hash_func hash;
 	cmp_func compare;
 	size_t data_size;
+	/* a map stores its key at the start of data, */
+	/* and its value at value_offset */
+	size_t key_size;
+	size_t value_offset;
+	size_t value_size;
 	size_t size;
 	size_t nmembs;
 	hash_slot *table;
+	/* while resizing, buckets [rehash_idx, old_size) of old_table
+	 * have not been migrated to table yet */
+	hash_slot *old_table;
+	size_t old_size;
+	size_t rehash_idx;
+	size_t init_size;
+	double max_load;
+	double min_load;
+	size_t rehash_step;
+	/* node allocator: deleted nodes are kept in free_nodes for reuse,
+	 * and all slabs are released at once by hash_free */
+	size_t node_size;
+	struct hash_slab *slabs;
+	unsigned char *slab_pos;
+	size_t slab_left;
+	hash_list *free_nodes;
+	struct hash_counters counters;
+	/* filter answering most searches for absent data, or NULL */
+	struct bloom *bloom;
+	/* engine other than HASH_CHAINED, and its private state */
+	const struct hash_ops *ops;
+	void *engine;
 } hash;
 
+/* fields left zero take their default value */
 struct hash_init {
+	/* rounded up to a power of two */
 	size_t size;
 	size_t data_size;
+	/* a nonzero key_size makes a map: each element is a key of */
+	/* key_size bytes followed by a value of value_size bytes, */
+	/* aligned for the value, and cmp_func and hash_func look at */
+	/* the key only; data_size is then computed */
+	size_t key_size;
+	size_t value_size;
 	cmp_func cmp_func;
+	/* NULL hashes all key_size bytes with hash_bytes */
 	hash_func hash_func;
+	/* grow the table when nmembs / size exceeds max_load */
+	double max_load;
+	/* shrink the table when nmembs / size falls below min_load;
+	 * zero disables shrinking. It is capped at max_load / 4, so a
+	 * shrunk table is at most half full and does not grow again
+	 * soon after */
+	double min_load;
+	/* number of buckets migrated per operation while resizing */
+	size_t rehash_step;
+	/* one of enum hash_type */
+	int type;
+	/* file of a HASH_MAPPED table */
+	const char *path;
 };
 
+/* chains of HASH_HIST_SIZE - 1 or more nodes share the last entry */
+#define HASH_HIST_SIZE (16)
+
+struct hash_stats {
+	size_t nmembs;
+	size_t size;
+	double load;
+	/* chain lengths of a chained table, probe distances of a */
+	/* HASH_ROBIN table, and zero for other engines */
+	size_t hist[HASH_HIST_SIZE];
+	size_t max_chain;
+	/* memory held by the table, including the hash structure */
+	size_t bytes;
+	/* from the operation counters */
+	double probes_per_hit;
+	double probes_per_miss;
+	struct hash_counters counters;
+};
+
+/* position of a cursor over a table; zero it before the first */
+/* hash_next. The table must not be modified during the walk, */
+/* which includes hash_search on a chained table being resized */
+struct hash_iter {
+	size_t pos;
+	void *node;
+};
+
+/* entry points of an engine selected by hash_init.type */
+struct hash_ops {
+	bool (*init)(hash *h, struct hash_init *h_init);
+	bool (*insert)(hash *h, const void *data);
+	bool (*delete)(hash *h, void *data);
+	void *(*search)(hash *h, const void *data);
+	void (*free)(hash *h);
+	/* fill bytes and hist of st */
+	void (*stats)(hash *h, struct hash_stats *st);
+	void *(*next)(hash *h, struct hash_iter *it);
+	/* find key, or add an element of key and zero bytes; */
+	/* return a pointer to the element */
+	void *(*get_or_insert)(hash *h, const void *key, bool *inserted);
+};
+
+#ifdef HASH_STATS
+#define HASH_STAT(stmt) stmt
+/* count a lookup that examined probes nodes or slots */
+static inline void hash_count_lookup(hash *h, bool found, size_t probes)
+{
+	if(found) {
+		h->counters.hits++;
+		h->counters.hit_probes += probes;
+	} else {
+		h->counters.misses++;
+		h->counters.miss_probes += probes;
+	}
+}
+#else
+#define HASH_STAT(stmt)
+#endif
+
+/* call cmp_func of h, counting the call */
+static inline int hash_cmp(hash *h, const void *x, const void *y)
+{
+	HASH_STAT(h->counters.compares++);
+	return h->compare(x, y);
+}
+
+/* built-in hash functions */
+/* mix the bits of a 64-bit integer (splitmix64 finalizer) */
+static inline uint64_t hash_mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+/* hash len bytes starting at data (wyhash) */
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed);
+/* hash_func for data beginning with an int or a uint64_t */
+uint64_t hash_int(const void *data);
+uint64_t hash_uint64(const void *data);
+
+/* hash code of data as computed by the table */
+static inline uint64_t hash_code(const hash *h, const void *data)
+{
+	return h->hash ? h->hash(data) : hash_bytes(data, h->key_size, 0);
+}
+
+/* value part of an element of a map */
+static inline void *hash_value(const hash *h, const void *data)
+{
+	return (unsigned char *)data + h->value_offset;
+}
+
 /* allocate and initialize a hash structure */
 /* return a pointer to new-allocated hash structure */
 hash *hash_init(struct hash_init *h_init);
@@ -48,8 +246,76 @@ bool hash_delete(hash *h, void *data);
 /* search data in hash table */
 /* if found, return a pointer to data; */
 /* if not found, return NULL */
+/* with open addressing engines the pointer is valid */
+/* until the next insert or delete */
 void *hash_search(hash *h, const void *data);
+/* same as hash_search, but never modifies the table, */
+/* so concurrent calls on a table nobody writes are safe */
+/* (except in a library built with -DHASH_STATS) */
+void *hash_find(hash *h, const void *data);
+/* report how many rehashes a full stash has forced in a HASH_CUCKOO */
+/* table, and how many elements are in the stash now */
+/* return false if h is not a HASH_CUCKOO table */
+bool hash_cuckoo_stats(hash *h, size_t *rehashes, size_t *stashed);
+/* write the contents of a HASH_CHAINED table to a file that */
+/* hash_map can map back; return true if written successfully */
+bool hash_save(hash *h, const char *path);
+/* map a file written by hash_save as a read-only HASH_MAPPED table, */
+/* using the callbacks in h_init, which must match the saved table */
+/* return NULL if failed */
+hash *hash_map(const char *path, struct hash_init *h_init);
+/* return a pointer to the value of key in a map, adding key */
+/* with a zeroed value if absent; *inserted tells which happened */
+/* key points to key_size bytes; the table hashes it once */
+/* return NULL if failed */
+void *hash_get_or_insert(hash *h, const void *key, bool *inserted);
+/* set the value of key in a map, adding key if absent */
+bool hash_upsert(hash *h, const void *key, const void *value);
+/* call fn on the value of key in a map, adding key with a zeroed */
+/* value first if absent; return the value, or NULL if failed */
+void *hash_update(hash *h, const void *key,
+		void (*fn)(void *value, bool inserted, void *arg), void *arg);
+/* put a Bloom filter (see bloom.h) sized for n elements with */
+/* false positive rate fp in front of h, filled with its elements; */
+/* a counting filter follows deletions, and a plain one keeps the */
+/* bits of deleted elements until hash_bloom_rebuild. Searches for */
+/* data the filter rejects then return NULL without probing h. */
+/* n of zero means nmembs; call again once h outgrows n */
+bool hash_bloom(hash *h, size_t n, double fp, bool counting);
+/* clear the filter of h and fill it again with the elements of h */
+bool hash_bloom_rebuild(hash *h);
+/* build a table from n elements stored one after another at data, */
+/* as if each were inserted in turn; a chained table is sized for n */
+/* at once, and its chains are built bucket by bucket in one pass */
+/* return a pointer to the new table, or NULL if failed */
+hash *hash_build(struct hash_init *h_init, const void *data, size_t n);
+/* return the element after the cursor and advance it, */
+/* or return NULL at the end; elements come in table order */
+void *hash_next(hash *h, struct hash_iter *it);
+/* call fn on every element, in the order of hash_next */
+void hash_foreach(hash *h, void (*fn)(void *data, void *arg), void *arg);
+/* finish any resize of a chained table, fit its size to nmembs */
+/* within the load factor limits, and move all nodes to one block */
+/* in bucket order, so that chains are read sequentially; pointers */
+/* to elements are invalidated. Other engines are left as they are */
+/* return false if failed, leaving h unchanged but for the resize */
+bool hash_compact(hash *h);
+/* fill st with the shape of the table and its counters */
+/* return false if h is NULL */
+bool hash_stats(hash *h, struct hash_stats *st);
+/* search n elements stored one after another at data, */
+/* setting results[i] as hash_search would for the i-th one; */
+/* cache misses of a group of lookups are overlapped */
+/* return the number of elements found */
+size_t hash_search_batch(hash *h, const void *data, size_t n, void **results);
+/* insert n elements stored one after another at data */
+/* return the number of elements inserted */
+size_t hash_insert_batch(hash *h, const void *data, size_t n);
 /* free all space used by hash */
 void hash_free(hash *h);
+/* report the longest and the mean probe distance of a HASH_ROBIN */
+/* table, where an element in its home slot has distance 0 */
+/* return false if h is not a HASH_ROBIN table */
+bool hash_robin_probes(hash *h, size_t *max, double *mean);
 
 #endif
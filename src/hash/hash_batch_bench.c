@@ -0,0 +1,79 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Probe throughput of hash_search against hash_search_batch on a
+ * chained table much larger than the last-level cache.
+ */
+
+#define NKEYS (1<<22)
+#define NPROBES (1<<22)
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+double now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+	struct hash_init h_init;
+	hash *h;
+	int *keys = malloc(NPROBES * sizeof(int));
+	void **results = malloc(NPROBES * sizeof(void *));
+	size_t i, found;
+	double start, single, batch;
+
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.size = NKEYS;
+	h_init.data_size = sizeof(int);
+	h_init.cmp_func = compare;
+	h_init.hash_func = hash_int;
+	h = hash_init(&h_init);
+	if(!h || !keys || !results) {
+		fprintf(stderr, "failed to initialize hash\n");
+		exit(EXIT_FAILURE);
+	}
+	/* insert in random order so that chains are scattered in memory */
+	srand(1);
+	for(i = 0; i < NKEYS; i++) {
+		int key = rand() % (2 * NKEYS);
+		hash_insert(h, &key);
+	}
+	for(i = 0; i < NPROBES; i++)
+		keys[i] = rand() % (2 * NKEYS);
+
+	start = now();
+	found = 0;
+	for(i = 0; i < NPROBES; i++)
+		found += hash_search(h, &keys[i]) != NULL;
+	single = now() - start;
+
+	start = now();
+	if(hash_search_batch(h, keys, NPROBES, results) != found) {
+		fprintf(stderr, "batch search error\n");
+		exit(EXIT_FAILURE);
+	}
+	batch = now() - start;
+
+	printf("hash_search:       %8.2f Mprobes/s\n", NPROBES / single / 1e6);
+	printf("hash_search_batch: %8.2f Mprobes/s\n", NPROBES / batch / 1e6);
+	hash_free(h);
+	free(keys);
+	free(results);
+	exit(EXIT_SUCCESS);
+}
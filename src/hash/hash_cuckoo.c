@@ -0,0 +1,487 @@
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ *    bucket i1                 bucket i2 = i1 ^ f(tag)
+ *    +----+----+----+----+     +----+----+----+----+
+ *    |tags|    |    |    |     |tags|    |    |    |
+ *    | d0 | d1 | d2 | d3 |     | d0 | d1 | d2 | d3 |
+ *    +----+----+----+----+     +----+----+----+----+
+ *
+ * Every element lives in one of the 4 slots of one of its two
+ * buckets. The first bucket comes from the hash code, the second is
+ * derived from the first and the element's 8-bit tag, so an element
+ * can be moved to its other bucket without hashing it again. A
+ * bucket is aligned to its size, a power of two, so it never spans
+ * more cache lines than needed and a lookup touches at most two
+ * buckets. When both buckets are full, insertion searches breadth
+ * first for a short path of moves ending in a free slot; if there is
+ * none the element goes to a small stash, and when the stash is full
+ * the table is rehashed to double size.
+ */
+
+#define CUCKOO_WAYS 4
+/* buckets visited by the breadth-first search for a free slot */
+#define CUCKOO_BFS_MAX 256
+#define CUCKOO_STASH_SIZE 8
+/* doublings tried by a rehash before giving up, which only happens */
+/* when many elements share a hash code */
+#define CUCKOO_REHASH_TRIES 4
+#define CUCKOO_MAX_LOAD 0.95
+#define CACHE_LINE 64
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct cuckoo {
+	/* buckets, aligned to bucket_size; raw is what malloc gave */
+	unsigned char *buckets;
+	void *raw;
+	size_t bucket_size;
+	size_t slot_size;
+	size_t data_size;
+	size_t nbuckets;
+	size_t max_nmembs;
+	double max_load;
+	/* elements for which no free slot could be made */
+	size_t nstash;
+	uint64_t stash_code[CUCKOO_STASH_SIZE];
+	unsigned char *stash;
+	/* stash of the table being built by cuckoo_rehash */
+	unsigned char *spare;
+	/* a key and zeroed value being added by get_or_insert */
+	unsigned char *scratch;
+	/* number of rehashes forced by a full stash */
+	size_t rehashes;
+};
+
+struct bfs_node {
+	size_t bucket;
+	int parent;
+	int slot;
+};
+
+static bool cuckoo_init(hash *h, struct hash_init *h_init);
+static bool cuckoo_insert(hash *h, const void *data);
+static bool cuckoo_delete(hash *h, void *data);
+static void *cuckoo_search(hash *h, const void *data);
+static void cuckoo_free(hash *h);
+static void cuckoo_stats(hash *h, struct hash_stats *st);
+static void *cuckoo_next(hash *h, struct hash_iter *it);
+static void *cuckoo_get_or_insert(hash *h, const void *key, bool *inserted);
+
+const struct hash_ops hash_cuckoo_ops = {
+	cuckoo_init,
+	cuckoo_insert,
+	cuckoo_delete,
+	cuckoo_search,
+	cuckoo_free,
+	cuckoo_stats,
+	cuckoo_next,
+	cuckoo_get_or_insert,
+};
+
+/* tag 0 marks a free slot */
+static unsigned char code_tag(uint64_t code)
+{
+	unsigned char tag = (unsigned char)(code >> 56);
+	return tag ? tag : 1;
+}
+
+static size_t first_bucket(const struct cuckoo *c, uint64_t code)
+{
+	return (size_t)code & (c->nbuckets - 1);
+}
+
+/* the other bucket of an element, in either direction. the offset */
+/* is never 0, so the two buckets differ even in a small table */
+static size_t alt_bucket(const struct cuckoo *c, size_t i, unsigned char tag)
+{
+	size_t off = (size_t)(tag * 0xc6a4a7935bd1e995ULL) & (c->nbuckets - 1);
+	return i ^ (off ? off : 1);
+}
+
+static unsigned char *tags_of(const struct cuckoo *c, size_t i)
+{
+	return c->buckets + i * c->bucket_size;
+}
+
+static void *slot_at(const struct cuckoo *c, size_t i, int way)
+{
+	return c->buckets + i * c->bucket_size + 8 + way * c->slot_size;
+}
+
+static void *stash_at(const struct cuckoo *c, size_t i)
+{
+	return c->stash + i * c->slot_size;
+}
+
+static int free_way(const struct cuckoo *c, size_t i)
+{
+	const unsigned char *tags = tags_of(c, i);
+	int w;
+	for(w = 0; w < CUCKOO_WAYS; w++)
+		if(tags[w] == 0)
+			return w;
+	return -1;
+}
+
+static bool cuckoo_alloc(struct cuckoo *c, size_t nbuckets)
+{
+	size_t align = c->bucket_size < CACHE_LINE ? c->bucket_size : CACHE_LINE;
+	void *raw = malloc(nbuckets * c->bucket_size + align);
+	if(!raw) return false;
+	c->raw = raw;
+	c->buckets = (unsigned char *)raw +
+		(align - (uintptr_t)raw % align) % align;
+	memset(c->buckets, 0, nbuckets * c->bucket_size);
+	c->nbuckets = nbuckets;
+	c->max_nmembs = (size_t)(c->max_load * nbuckets * CUCKOO_WAYS);
+	return true;
+}
+
+/* look for data in both buckets and the stash; set *bucket and *way, */
+/* way being -1 - index for a stashed element */
+static bool cuckoo_find(hash *h, const void *data, uint64_t code,
+		size_t *bucket, int *way)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	unsigned char tag = code_tag(code);
+	size_t i[2];
+	int k, w;
+
+	i[0] = first_bucket(c, code);
+	i[1] = alt_bucket(c, i[0], tag);
+	for(k = 0; k < 2; k++) {
+		const unsigned char *tags = tags_of(c, i[k]);
+		for(w = 0; w < CUCKOO_WAYS; w++) {
+			if(tags[w] == tag &&
+					hash_cmp(h, slot_at(c, i[k], w), data) == 0) {
+				HASH_STAT(hash_count_lookup(h, true, k + 1));
+				*bucket = i[k];
+				*way = w;
+				return true;
+			}
+		}
+	}
+	/* the stash counts as a third probe */
+	for(k = 0; k < (int)c->nstash; k++) {
+		if(c->stash_code[k] == code &&
+				hash_cmp(h, stash_at(c, k), data) == 0) {
+			HASH_STAT(hash_count_lookup(h, true, 3));
+			*way = -1 - k;
+			return true;
+		}
+	}
+	HASH_STAT(hash_count_lookup(h, false, c->nstash ? 3 : 2));
+	return false;
+}
+
+/* make a slot free in bucket i1 or i2 by moving elements along the */
+/* shortest path found; return the bucket and set *way, or -1 */
+static long cuckoo_make_room(struct cuckoo *c, size_t i1, size_t i2, int *way)
+{
+	struct bfs_node queue[CUCKOO_BFS_MAX];
+	int head = 0, tail = 0;
+	int w;
+
+	queue[tail++] = (struct bfs_node){ i1, -1, -1 };
+	queue[tail++] = (struct bfs_node){ i2, -1, -1 };
+	while(head < tail) {
+		int n = head++;
+		int free = free_way(c, queue[n].bucket);
+		if(free >= 0) {
+			/* move elements from the end of the path backward */
+			while(queue[n].parent >= 0) {
+				struct bfs_node *p = &queue[queue[n].parent];
+				unsigned char *ptags = tags_of(c, p->bucket);
+				unsigned char tag = ptags[queue[n].slot];
+				/* a bucket met twice on the path may have
+				 * changed under us; give up on the path */
+				if(tag == 0 || alt_bucket(c, p->bucket, tag) !=
+						queue[n].bucket)
+					return -1;
+				tags_of(c, queue[n].bucket)[free] = tag;
+				memcpy(slot_at(c, queue[n].bucket, free),
+						slot_at(c, p->bucket, queue[n].slot),
+						c->slot_size);
+				ptags[queue[n].slot] = 0;
+				free = queue[n].slot;
+				n = queue[n].parent;
+			}
+			*way = free;
+			return (long)queue[n].bucket;
+		}
+		for(w = 0; w < CUCKOO_WAYS && tail < CUCKOO_BFS_MAX; w++) {
+			unsigned char tag = tags_of(c, queue[n].bucket)[w];
+			queue[tail++] = (struct bfs_node){
+				alt_bucket(c, queue[n].bucket, tag), n, w };
+		}
+	}
+	return -1;
+}
+
+/* place data known to be absent and return where it went, or NULL */
+/* if the stash is full */
+static void *cuckoo_place(struct cuckoo *c, const void *data, uint64_t code)
+{
+	unsigned char tag = code_tag(code);
+	size_t i1 = first_bucket(c, code);
+	size_t i2 = alt_bucket(c, i1, tag);
+	long bucket;
+	int way;
+
+	if((way = free_way(c, i1)) >= 0)
+		bucket = (long)i1;
+	else if((way = free_way(c, i2)) >= 0)
+		bucket = (long)i2;
+	else
+		bucket = cuckoo_make_room(c, i1, i2, &way);
+	if(bucket >= 0) {
+		tags_of(c, bucket)[way] = tag;
+		memcpy(slot_at(c, bucket, way), data, c->data_size);
+		return slot_at(c, bucket, way);
+	}
+	if(c->nstash == CUCKOO_STASH_SIZE)
+		return NULL;
+	c->stash_code[c->nstash] = code;
+	memcpy(stash_at(c, c->nstash), data, c->data_size);
+	return stash_at(c, c->nstash++);
+}
+
+/* move all elements, and data if not NULL, into a table of at least */
+/* nbuckets buckets, setting *placed to where data went. the new table */
+/* is built apart, with the spare stash, and only replaces the old one */
+/* once every element is placed, so that a failure leaves the table */
+/* as it was */
+static bool cuckoo_rehash(hash *h, size_t nbuckets, const void *data,
+		uint64_t code, void **placed)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	struct cuckoo new = *c;
+	size_t i;
+	int w, tries;
+
+	new.stash = c->spare;
+	for(tries = 0; tries < CUCKOO_REHASH_TRIES; tries++, nbuckets *= 2) {
+		if(!cuckoo_alloc(&new, nbuckets)) {
+			hash_error("failed to allocate memory");
+			return false;
+		}
+		new.nstash = 0;
+		bool ok = true;
+		for(i = 0; ok && i < c->nbuckets; i++)
+			for(w = 0; ok && w < CUCKOO_WAYS; w++)
+				if(tags_of(c, i)[w])
+					ok = cuckoo_place(&new, slot_at(c, i, w),
+						hash_mix64(hash_code(h, slot_at(c, i, w)))) != NULL;
+		for(i = 0; ok && i < c->nstash; i++)
+			ok = cuckoo_place(&new, stash_at(c, i),
+					c->stash_code[i]) != NULL;
+		if(ok && data)
+			ok = (*placed = cuckoo_place(&new, data, code)) != NULL;
+		if(ok) {
+			free(c->raw);
+			new.spare = c->stash;
+			*c = new;
+			return true;
+		}
+		/* unlucky even at this size; try a larger one */
+		free(new.raw);
+	}
+	hash_error("no room found after rehashing");
+	return false;
+}
+
+bool cuckoo_init(hash *h, struct hash_init *h_init)
+{
+	struct cuckoo *c = (struct cuckoo *)malloc(sizeof(struct cuckoo));
+	size_t size = h_init->size ? h_init->size : HASH_INIT_SIZE;
+	size_t nbuckets = 2;
+	size_t align = 1;
+
+	if(!c) return false;
+	while(align < h->data_size && align < 8)
+		align *= 2;
+	c->slot_size = (h->data_size + align - 1) / align * align;
+	c->data_size = h->data_size;
+	/* 4 tags, padded to keep the slots aligned */
+	c->bucket_size = 1;
+	while(c->bucket_size < 8 + CUCKOO_WAYS * c->slot_size)
+		c->bucket_size *= 2;
+	c->stash = (unsigned char *)malloc(CUCKOO_STASH_SIZE * c->slot_size);
+	c->spare = (unsigned char *)malloc(CUCKOO_STASH_SIZE * c->slot_size);
+	c->scratch = (unsigned char *)malloc(c->slot_size);
+	while(nbuckets * CUCKOO_WAYS < size)
+		nbuckets *= 2;
+	c->max_load = h_init->max_load > 0 && h_init->max_load < 1 ?
+		h_init->max_load : CUCKOO_MAX_LOAD;
+	c->nstash = 0;
+	c->rehashes = 0;
+	if(!c->stash || !c->spare || !c->scratch ||
+			!cuckoo_alloc(c, nbuckets)) {
+		free(c->stash);
+		free(c->spare);
+		free(c->scratch);
+		free(c);
+		return false;
+	}
+	h->engine = c;
+	h->size = c->nbuckets * CUCKOO_WAYS;
+	return true;
+}
+
+/* add data known to be absent, growing the table if needed */
+/* return where it went, or NULL if failed */
+static void *cuckoo_add(hash *h, const void *data, uint64_t code)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	void *slot;
+
+	if(h->nmembs + 1 > c->max_nmembs &&
+			!cuckoo_rehash(h, c->nbuckets * 2, NULL, 0, NULL))
+		return NULL;
+	if(!(slot = cuckoo_place(c, data, code))) {
+		c->rehashes++;
+		if(!cuckoo_rehash(h, c->nbuckets * 2, data, code, &slot))
+			return NULL;
+	}
+	h->size = c->nbuckets * CUCKOO_WAYS;
+	h->nmembs++;
+	return slot;
+}
+
+bool cuckoo_insert(hash *h, const void *data)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, data));
+	size_t bucket;
+	int way;
+
+	if(cuckoo_find(h, data, code, &bucket, &way)) {
+		memcpy(way >= 0 ? slot_at(c, bucket, way) :
+				stash_at(c, -1 - way), data, h->data_size);
+		return true;
+	}
+	return cuckoo_add(h, data, code) != NULL;
+}
+
+/* hash key once, and look in its buckets and the stash before */
+/* adding it with a zeroed value */
+void *cuckoo_get_or_insert(hash *h, const void *key, bool *inserted)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, key));
+	size_t bucket;
+	int way;
+
+	*inserted = false;
+	if(cuckoo_find(h, key, code, &bucket, &way))
+		return way >= 0 ? slot_at(c, bucket, way) : stash_at(c, -1 - way);
+	memcpy(c->scratch, key, h->key_size);
+	memset(c->scratch + h->key_size, 0, h->data_size - h->key_size);
+	*inserted = true;
+	return cuckoo_add(h, c->scratch, code);
+}
+
+bool cuckoo_delete(hash *h, void *data)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, data));
+	size_t bucket, i;
+	int way;
+
+	if(!cuckoo_find(h, data, code, &bucket, &way))
+		return false;
+	if(way >= 0) {
+		memcpy(data, slot_at(c, bucket, way), h->data_size);
+		tags_of(c, bucket)[way] = 0;
+		/* give a stashed element the slot if it belongs here */
+		for(i = 0; i < c->nstash; i++) {
+			unsigned char tag = code_tag(c->stash_code[i]);
+			size_t i1 = first_bucket(c, c->stash_code[i]);
+			if(i1 != bucket && alt_bucket(c, i1, tag) != bucket)
+				continue;
+			tags_of(c, bucket)[way] = tag;
+			memcpy(slot_at(c, bucket, way), stash_at(c, i),
+					c->slot_size);
+			c->nstash--;
+			c->stash_code[i] = c->stash_code[c->nstash];
+			memcpy(stash_at(c, i), stash_at(c, c->nstash),
+					c->slot_size);
+			break;
+		}
+	} else {
+		i = -1 - way;
+		memcpy(data, stash_at(c, i), h->data_size);
+		c->nstash--;
+		c->stash_code[i] = c->stash_code[c->nstash];
+		memcpy(stash_at(c, i), stash_at(c, c->nstash), c->slot_size);
+	}
+	h->nmembs--;
+	return true;
+}
+
+void *cuckoo_search(hash *h, const void *data)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, data));
+	size_t bucket;
+	int way;
+
+	if(!cuckoo_find(h, data, code, &bucket, &way))
+		return NULL;
+	return way >= 0 ? slot_at(c, bucket, way) : stash_at(c, -1 - way);
+}
+
+void cuckoo_free(hash *h)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	free(c->raw);
+	free(c->stash);
+	free(c->spare);
+	free(c->scratch);
+	free(c);
+}
+
+/* report how many rehashes a full stash has forced in a HASH_CUCKOO */
+/* table, and how many elements are in the stash now */
+/* return false if h is not a HASH_CUCKOO table */
+bool hash_cuckoo_stats(hash *h, size_t *rehashes, size_t *stashed)
+{
+	if(!h || h->ops != &hash_cuckoo_ops) return false;
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	if(rehashes)
+		*rehashes = c->rehashes;
+	if(stashed)
+		*stashed = c->nstash;
+	return true;
+}
+
+void cuckoo_stats(hash *h, struct hash_stats *st)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	size_t align = c->bucket_size < CACHE_LINE ? c->bucket_size : CACHE_LINE;
+	st->bytes += sizeof(struct cuckoo) +
+		c->nbuckets * c->bucket_size + align +
+		(2 * CUCKOO_STASH_SIZE + 1) * c->slot_size;
+}
+
+/* pos counts the slots of all buckets, then the stash */
+void *cuckoo_next(hash *h, struct hash_iter *it)
+{
+	struct cuckoo *c = (struct cuckoo *)h->engine;
+	size_t nslots = c->nbuckets * CUCKOO_WAYS;
+	while(it->pos < nslots) {
+		size_t i = it->pos / CUCKOO_WAYS;
+		int w = (int)(it->pos++ % CUCKOO_WAYS);
+		if(tags_of(c, i)[w] != 0)
+			return slot_at(c, i, w);
+	}
+	if(it->pos - nslots < c->nstash)
+		return stash_at(c, it->pos++ - nslots);
+	return NULL;
+}
@@ -0,0 +1,232 @@
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <string.h>
+
+#define MAXSIZE (1<<20)
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+struct pair {
+	int key;
+	int value;
+};
+
+/* every element collides: they all share two buckets and the stash */
+uint64_t collide(const void *data)
+{
+	(void)data;
+	return 42;
+}
+
+size_t hashed;
+
+/* hash_int, counting the calls */
+uint64_t count_hash(const void *data)
+{
+	hashed++;
+	return hash_int(data);
+}
+
+int main(void)
+{
+	hash *h;
+	int i, tmp;
+	int *p;
+	size_t rehashes, stashed;
+	struct hash_init h_init;
+
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.type = HASH_CUCKOO;
+	h_init.size = 16;
+	h_init.data_size = sizeof(int);
+	h_init.cmp_func = compare;
+	h_init.hash_func = hash_int;
+	h = hash_init(&h_init);
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	char tested[MAXSIZE];
+
+	memset(tested, 0, MAXSIZE);
+	for(i = 0; i < MAXSIZE; i++) {
+		if(!hash_insert(h, &i)) {
+			fprintf(stderr, "insert error\n");
+			goto FAILED;
+		}
+	}
+	/* inserting an equal element replaces it */
+	for(i = 0; i < MAXSIZE; i += 2) {
+		if(!hash_insert(h, &i)) {
+			fprintf(stderr, "insert error\n");
+			goto FAILED;
+		}
+	}
+	if(h->nmembs != MAXSIZE) {
+		fprintf(stderr, "insert error\n");
+		goto FAILED;
+	}
+
+	for(i = MAXSIZE - 1; i >= 0; i--) {
+		p = hash_search(h, &i);
+		if(p == NULL || *p != i) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+
+	/* a full stash, which forces a rehash, should be rare */
+	if(!hash_cuckoo_stats(h, &rehashes, &stashed) || rehashes > 2) {
+		fprintf(stderr, "cuckoo stats error\n");
+		goto FAILED;
+	}
+
+	srand((unsigned int)time(0));
+	for(i = 0; i < MAXSIZE / 2; i++) {
+		tmp = (int)rand() % MAXSIZE;
+		bool res = hash_delete(h, &tmp);
+		if(!res) {
+			if(!tested[tmp]) {
+				fprintf(stderr, "delete error\n");
+				goto FAILED;
+			}
+		} else {
+			if(tested[tmp]) {
+				fprintf(stderr, "delete error\n");
+				goto FAILED;
+			}
+			tested[tmp] = 1;
+		}
+	}
+
+	/* reinsert into slots freed by deletion */
+	for(i = 0; i < MAXSIZE; i++) {
+		if((hash_search(h, &i) == NULL) != tested[i]) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+		if(tested[i] && i % 2 == 0) {
+			if(!hash_insert(h, &i)) {
+				fprintf(stderr, "insert error\n");
+				goto FAILED;
+			}
+			tested[i] = 0;
+		}
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		if((hash_search(h, &i) == NULL) != tested[i]) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+	/* every element is visited once */
+	struct hash_iter it = { 0, NULL };
+	size_t count = 0;
+	while((p = hash_next(h, &it)) != NULL) {
+		if(tested[*p] || hash_search(h, p) != p) {
+			fprintf(stderr, "iteration error\n");
+			goto FAILED;
+		}
+		count++;
+	}
+	if(count != h->nmembs) {
+		fprintf(stderr, "iteration error\n");
+		goto FAILED;
+	}
+	hash_free(h);
+
+	/* fill the two buckets and the stash of one hash code, until a */
+	/* rehash gives up; the table must be left as it was */
+	struct pair pair, *q;
+	int n;
+	h_init.size = 0;
+	h_init.data_size = sizeof(struct pair);
+	h_init.hash_func = collide;
+	h = hash_init(&h_init);
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	for(n = 0; n < 100; n++) {
+		pair.key = n;
+		pair.value = -n;
+		if(!hash_insert(h, &pair))
+			break;
+	}
+	if(n != 16 || h->nmembs != (size_t)n ||
+			!hash_cuckoo_stats(h, &rehashes, &stashed) ||
+			stashed != 8) {
+		fprintf(stderr, "insert error\n");
+		goto FAILED;
+	}
+	for(i = 0; i <= n; i++) {
+		q = hash_search(h, &i);
+		if((q != NULL) != (i < n) || (q && q->value != -i)) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+	for(i = 0; i < n; i++) {
+		pair.key = i;
+		if(!hash_delete(h, &pair) || pair.value != -i) {
+			fprintf(stderr, "delete error\n");
+			goto FAILED;
+		}
+	}
+	if(h->nmembs != 0) {
+		fprintf(stderr, "delete error\n");
+		goto FAILED;
+	}
+	hash_free(h);
+
+	/* get_or_insert hashes a key once, and finds it in the */
+	/* buckets or the stash */
+	bool inserted;
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.type = HASH_CUCKOO;
+	h_init.size = 16;
+	h_init.key_size = sizeof(int);
+	h_init.value_size = sizeof(int);
+	h_init.cmp_func = compare;
+	h_init.hash_func = count_hash;
+	h = hash_init(&h_init);
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE / 16; i++) {
+		p = (int *)hash_get_or_insert(h, &i, &inserted);
+		if(!p || !inserted) {
+			fprintf(stderr, "get_or_insert error\n");
+			goto FAILED;
+		}
+		*p = -i;
+	}
+	hashed = 0;
+	for(i = 0; i < MAXSIZE / 16; i++) {
+		p = (int *)hash_get_or_insert(h, &i, &inserted);
+		if(!p || inserted || *p != -i) {
+			fprintf(stderr, "get_or_insert error\n");
+			goto FAILED;
+		}
+	}
+	if(hashed != MAXSIZE / 16 || h->nmembs != MAXSIZE / 16) {
+		fprintf(stderr, "get_or_insert error\n");
+		goto FAILED;
+	}
+	hash_free(h);
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
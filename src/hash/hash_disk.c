@@ -0,0 +1,717 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_disk.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*
+ *    main file:  | header | bucket 0 | bucket 1 | ... | bucket n-1 |
+ *                              |
+ *                              v next
+ *    .ovf file:  | unused | overflow | overflow | ...
+ *
+ *    page:       | nrecs | next | code, data | code, data | ...    |
+ *
+ * With 2^level <= nbuckets < 2^(level + 1), the low level bits of
+ * the code of an element give its bucket, unless that bucket has
+ * already been split in this round (it is below split), in which
+ * case one more bit is used. Splitting bucket split moves the
+ * elements whose extra bit is set to the new bucket 2^level + split.
+ * A next of zero ends a chain; freed overflow pages are chained from
+ * ovf_free. Each record is the 64-bit code followed by the data,
+ * padded to 8 bytes, and integers are in native byte order.
+ */
+
+#define DISK_MAGIC 0x4b53494448534148ULL	/* "HASHDISK" */
+#define DISK_VERSION 1
+#define MAIN 0
+#define OVF 1
+/* fewest frames: an operation pins at most three pages at once */
+#define MIN_FRAMES 4
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct disk_header {
+	uint64_t magic;
+	uint64_t version;
+	uint64_t page_size;
+	uint64_t data_size;
+	uint64_t level;
+	uint64_t split;
+	uint64_t nbuckets;
+	uint64_t nmembs;
+	/* overflow pages in the .ovf file, and the first free one */
+	uint64_t novf;
+	uint64_t ovf_free;
+};
+
+struct page_head {
+	uint32_t nrecs;
+	uint32_t unused;
+	uint64_t next;
+};
+
+struct frame {
+	unsigned char *data;
+	/* page << 1 | file */
+	uint64_t id;
+	int pins;
+	bool valid;
+	bool dirty;
+	unsigned char ref;
+};
+
+struct hash_disk {
+	int fd[2];
+	struct disk_header hd;
+	hash_func hash;
+	cmp_func compare;
+	double max_load;
+	size_t record_size;
+	size_t per_page;
+	struct frame *frames;
+	unsigned char *pool;
+	size_t nframes;
+	size_t hand;
+	/* page id to frame index */
+	hash *index;
+	size_t reads;
+	size_t writes;
+	/* records of the bucket being split */
+	unsigned char *buf;
+	size_t buf_size;
+};
+
+struct index_entry {
+	uint64_t id;
+	size_t frame;
+};
+
+static int compare_id(const void *x, const void *y)
+{
+	const uint64_t *a = (uint64_t *)x;
+	const uint64_t *b = (uint64_t *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+static uint64_t disk_code(const hash_disk *d, const void *data)
+{
+	return hash_mix64(d->hash ? d->hash(data) :
+			hash_bytes(data, d->hd.data_size, 0));
+}
+
+static uint64_t bucket_of(const hash_disk *d, uint64_t code)
+{
+	uint64_t b = code & (((uint64_t)1 << d->hd.level) - 1);
+	if(b < d->hd.split)
+		b = code & (((uint64_t)2 << d->hd.level) - 1);
+	return b;
+}
+
+static struct page_head *head_of(struct frame *f)
+{
+	return (struct page_head *)f->data;
+}
+
+static unsigned char *record_at(const hash_disk *d, struct frame *f,
+		size_t i)
+{
+	return f->data + sizeof(struct page_head) + i * d->record_size;
+}
+
+static bool page_read(hash_disk *d, int file, uint64_t pno,
+		unsigned char *buf)
+{
+	ssize_t n = pread(d->fd[file], buf, HASH_DISK_PAGE,
+			(off_t)(pno * HASH_DISK_PAGE));
+	if(n < 0) {
+		hash_error("failed to read page");
+		return false;
+	}
+	/* pages past the end of the file are empty */
+	memset(buf + n, 0, HASH_DISK_PAGE - (size_t)n);
+	d->reads++;
+	return true;
+}
+
+static bool page_write(hash_disk *d, struct frame *f)
+{
+	if(pwrite(d->fd[f->id & 1], f->data, HASH_DISK_PAGE,
+				(off_t)((f->id >> 1) * HASH_DISK_PAGE)) !=
+			HASH_DISK_PAGE) {
+		hash_error("failed to write page");
+		return false;
+	}
+	f->dirty = false;
+	d->writes++;
+	return true;
+}
+
+/* pin the frame holding a page, reading it in unless fresh, */
+/* in which case it starts empty; return NULL if failed */
+static struct frame *page_get(hash_disk *d, int file, uint64_t pno,
+		bool fresh)
+{
+	uint64_t id = pno << 1 | (uint64_t)file;
+	void *data = hash_find(d->index, &id);
+	struct index_entry e;
+	struct frame *f;
+
+	if(data) {
+		f = &d->frames[*(size_t *)hash_value(d->index, data)];
+		if(fresh) {
+			memset(f->data, 0, HASH_DISK_PAGE);
+			f->dirty = true;
+		}
+	} else {
+		/* CLOCK: pass over pinned frames and recently used ones */
+		for(;;) {
+			f = &d->frames[d->hand];
+			d->hand = (d->hand + 1) % d->nframes;
+			if(f->pins)
+				continue;
+			if(f->valid && f->ref) {
+				f->ref = 0;
+				continue;
+			}
+			break;
+		}
+		if(f->valid) {
+			if(f->dirty && !page_write(d, f))
+				return NULL;
+			e.id = f->id;
+			hash_delete(d->index, &e);
+			f->valid = false;
+		}
+		if(fresh)
+			memset(f->data, 0, HASH_DISK_PAGE);
+		else if(!page_read(d, file, pno, f->data))
+			return NULL;
+		e.id = id;
+		e.frame = (size_t)(f - d->frames);
+		if(!hash_insert(d->index, &e))
+			return NULL;
+		f->id = id;
+		f->valid = true;
+		f->dirty = fresh;
+	}
+	f->ref = 1;
+	f->pins++;
+	return f;
+}
+
+static void page_put(struct frame *f)
+{
+	f->pins--;
+}
+
+/* pin an empty overflow page and set *pno to its number */
+/* return NULL if failed */
+static struct frame *ovf_new(hash_disk *d, uint64_t *pno)
+{
+	struct frame *f;
+
+	*pno = d->hd.ovf_free;
+	if(*pno) {
+		f = page_get(d, OVF, *pno, false);
+		if(!f) return NULL;
+		d->hd.ovf_free = head_of(f)->next;
+		memset(f->data, 0, sizeof(struct page_head));
+		f->dirty = true;
+	} else {
+		*pno = d->hd.novf + 1;
+		f = page_get(d, OVF, *pno, true);
+		if(!f) return NULL;
+		d->hd.novf = *pno;
+	}
+	return f;
+}
+
+/* return the number of an empty overflow page, or 0 if failed */
+static uint64_t ovf_alloc(hash_disk *d)
+{
+	uint64_t pno;
+	struct frame *f = ovf_new(d, &pno);
+
+	if(!f) return 0;
+	page_put(f);
+	return pno;
+}
+
+/* put the pinned overflow page pno on the free list */
+static void ovf_release(hash_disk *d, struct frame *f, uint64_t pno)
+{
+	head_of(f)->nrecs = 0;
+	head_of(f)->next = d->hd.ovf_free;
+	d->hd.ovf_free = pno;
+	f->dirty = true;
+}
+
+/* free the overflow chain starting at pno; failing to read a page */
+/* only leaks the rest */
+static void chain_free(hash_disk *d, uint64_t pno)
+{
+	while(pno) {
+		struct frame *f = page_get(d, OVF, pno, false);
+		uint64_t next;
+		if(!f) {
+			hash_error("failed to free overflow pages");
+			return;
+		}
+		next = head_of(f)->next;
+		ovf_release(d, f, pno);
+		page_put(f);
+		pno = next;
+	}
+}
+
+/* write n records of d->buf, from record first on, to new overflow */
+/* pages, last page first, and set *head to the first of them */
+/* return false if failed, freeing the pages written */
+static bool chain_build(hash_disk *d, size_t first, size_t n,
+		uint64_t *head)
+{
+	uint64_t pno;
+
+	*head = 0;
+	while(n) {
+		size_t k = (n - 1) % d->per_page + 1;
+		struct frame *f = ovf_new(d, &pno);
+		if(!f) {
+			chain_free(d, *head);
+			*head = 0;
+			return false;
+		}
+		n -= k;
+		head_of(f)->nrecs = (uint32_t)k;
+		head_of(f)->next = *head;
+		memcpy(record_at(d, f, 0), d->buf + (first + n) * d->record_size,
+				k * d->record_size);
+		f->dirty = true;
+		page_put(f);
+		*head = pno;
+	}
+	return true;
+}
+
+/* add a record to the first page of bucket b with room for it */
+static bool chain_append(hash_disk *d, uint64_t b, uint64_t code,
+		const void *data)
+{
+	int file = MAIN;
+	uint64_t pno = b + 1;
+
+	for(;;) {
+		struct frame *f = page_get(d, file, pno, false);
+		struct page_head *h;
+		if(!f) return false;
+		h = head_of(f);
+		if(h->nrecs < d->per_page) {
+			unsigned char *r = record_at(d, f, h->nrecs++);
+			memcpy(r, &code, sizeof(uint64_t));
+			memcpy(r + sizeof(uint64_t), data, d->hd.data_size);
+			f->dirty = true;
+			page_put(f);
+			return true;
+		}
+		if(!h->next) {
+			uint64_t next = ovf_alloc(d);
+			if(!next) {
+				page_put(f);
+				return false;
+			}
+			h->next = next;
+			f->dirty = true;
+		}
+		pno = h->next;
+		file = OVF;
+		page_put(f);
+	}
+}
+
+/* copy the records of bucket b to d->buf, leaving room for one */
+/* more; return how many, or (size_t)-1 if failed */
+static size_t bucket_copy(hash_disk *d, uint64_t b)
+{
+	uint64_t pno = b + 1;
+	size_t n = 0;
+	int file = MAIN;
+
+	for(;;) {
+		struct frame *f = page_get(d, file, pno, false);
+		struct page_head *h;
+		if(!f) return (size_t)-1;
+		h = head_of(f);
+		if((n + h->nrecs + 1) * d->record_size > d->buf_size) {
+			size_t size = d->buf_size * 2 +
+				(h->nrecs + 1) * d->record_size;
+			unsigned char *buf = (unsigned char *)realloc(d->buf, size);
+			if(!buf) {
+				hash_error("failed to allocate memory");
+				page_put(f);
+				return (size_t)-1;
+			}
+			d->buf = buf;
+			d->buf_size = size;
+		}
+		memcpy(d->buf + n * d->record_size, record_at(d, f, 0),
+				h->nrecs * d->record_size);
+		n += h->nrecs;
+		pno = h->next;
+		page_put(f);
+		if(!pno)
+			return n;
+		file = OVF;
+	}
+}
+
+/* split the next bucket of this round; return false if failed, */
+/* leaving the table unsplit. both halves are written before the */
+/* bucket is switched to them, so a failure loses no record */
+static bool split_one(hash_disk *d)
+{
+	uint64_t b = d->hd.split, bit = (uint64_t)1 << d->hd.level;
+	uint64_t old, stay_ovf, move_ovf;
+	size_t rs = d->record_size, n, ns = 0, s1, m1, i;
+	struct frame *fb, *fn;
+	bool res = false;
+
+	/* pin the bucket and the new one just past the last, so that */
+	/* switching to the written halves cannot fail */
+	fb = page_get(d, MAIN, b + 1, false);
+	if(!fb) return false;
+	fn = page_get(d, MAIN, d->hd.nbuckets + 1, true);
+	if(!fn) {
+		page_put(fb);
+		return false;
+	}
+	n = bucket_copy(d, b);
+	if(n == (size_t)-1)
+		goto OUT;
+	/* put the records that stay first, swapping through slot n */
+	for(i = 0; i < n; i++) {
+		unsigned char *r = d->buf + i * rs, *t = d->buf + n * rs;
+		uint64_t code;
+		memcpy(&code, r, sizeof(uint64_t));
+		if(code & bit)
+			continue;
+		if(i != ns) {
+			memcpy(t, r, rs);
+			memcpy(r, d->buf + ns * rs, rs);
+			memcpy(d->buf + ns * rs, t, rs);
+		}
+		ns++;
+	}
+	/* what does not fit in the main pages goes to new overflow */
+	s1 = ns < d->per_page ? ns : d->per_page;
+	m1 = n - ns < d->per_page ? n - ns : d->per_page;
+	if(!chain_build(d, s1, ns - s1, &stay_ovf))
+		goto OUT;
+	if(!chain_build(d, ns + m1, n - ns - m1, &move_ovf)) {
+		chain_free(d, stay_ovf);
+		goto OUT;
+	}
+
+	old = head_of(fb)->next;
+	head_of(fb)->nrecs = (uint32_t)s1;
+	head_of(fb)->next = stay_ovf;
+	memcpy(record_at(d, fb, 0), d->buf, s1 * rs);
+	fb->dirty = true;
+	head_of(fn)->nrecs = (uint32_t)m1;
+	head_of(fn)->next = move_ovf;
+	memcpy(record_at(d, fn, 0), d->buf + ns * rs, m1 * rs);
+	fn->dirty = true;
+	d->hd.nbuckets++;
+	if(++d->hd.split == bit) {
+		d->hd.level++;
+		d->hd.split = 0;
+	}
+	chain_free(d, old);
+	res = true;
+OUT:
+	page_put(fn);
+	page_put(fb);
+	return res;
+}
+
+hash_disk *hash_disk_open(struct hash_init *h_init, size_t nframes)
+{
+	if(!h_init || !h_init->path || !h_init->data_size ||
+			!h_init->cmp_func) {
+		hash_error("incorrect hash_init structure");
+		return NULL;
+	}
+	hash_disk *d = (hash_disk *)calloc(1, sizeof(hash_disk));
+	size_t len = strlen(h_init->path);
+	char *ovf_path = (char *)malloc(len + 5);
+	struct hash_init index_init;
+	struct stat st;
+	size_t i;
+
+	if(!d || !ovf_path) {
+		hash_error("failed to allocate memory");
+		free(d);
+		free(ovf_path);
+		return NULL;
+	}
+	d->fd[MAIN] = -1;
+	d->fd[OVF] = -1;
+	d->hash = h_init->hash_func;
+	d->compare = h_init->cmp_func;
+	d->max_load = h_init->max_load > 0 ?
+		h_init->max_load : HASH_DISK_MAX_LOAD;
+	d->record_size = (sizeof(uint64_t) + h_init->data_size + 7) &
+		~(size_t)7;
+	d->per_page = (HASH_DISK_PAGE - sizeof(struct page_head)) /
+		d->record_size;
+	d->nframes = nframes > MIN_FRAMES ? nframes :
+		nframes ? MIN_FRAMES : HASH_DISK_FRAMES;
+	if(d->per_page == 0) {
+		hash_error("data_size is larger than a page");
+		goto FAILED;
+	}
+	memcpy(ovf_path, h_init->path, len);
+	memcpy(ovf_path + len, ".ovf", 5);
+	/* the overflow file of an existing table must exist too */
+	d->fd[MAIN] = open(h_init->path, O_RDWR | O_CREAT, 0644);
+	if(d->fd[MAIN] >= 0 && fstat(d->fd[MAIN], &st) == 0)
+		d->fd[OVF] = open(ovf_path, st.st_size > 0 ?
+				O_RDWR : O_RDWR | O_CREAT, 0644);
+	if(d->fd[MAIN] < 0 || d->fd[OVF] < 0) {
+		hash_error("failed to open file");
+		goto FAILED;
+	}
+
+	if(st.st_size > 0) {
+		if(pread(d->fd[MAIN], &d->hd, sizeof(d->hd), 0) !=
+					sizeof(d->hd) ||
+				d->hd.magic != DISK_MAGIC ||
+				d->hd.version != DISK_VERSION ||
+				d->hd.page_size != HASH_DISK_PAGE ||
+				d->hd.data_size != h_init->data_size) {
+			hash_error("incorrect file");
+			goto FAILED;
+		}
+	} else {
+		d->hd.magic = DISK_MAGIC;
+		d->hd.version = DISK_VERSION;
+		d->hd.page_size = HASH_DISK_PAGE;
+		d->hd.data_size = h_init->data_size;
+		d->hd.nbuckets = 1;
+		while(d->hd.nbuckets * d->per_page * d->max_load < h_init->size) {
+			d->hd.nbuckets *= 2;
+			d->hd.level++;
+		}
+		/* bucket pages past the end of the file read as empty */
+		if(ftruncate(d->fd[OVF], 0) < 0 ||
+				ftruncate(d->fd[MAIN], HASH_DISK_PAGE) < 0) {
+			hash_error("failed to create file");
+			goto FAILED;
+		}
+	}
+
+	d->frames = (struct frame *)calloc(d->nframes, sizeof(struct frame));
+	d->pool = (unsigned char *)malloc(d->nframes * HASH_DISK_PAGE);
+	memset(&index_init, 0, sizeof(index_init));
+	index_init.size = d->nframes;
+	index_init.key_size = sizeof(uint64_t);
+	index_init.value_size = sizeof(size_t);
+	index_init.cmp_func = compare_id;
+	index_init.hash_func = hash_uint64;
+	d->index = hash_init(&index_init);
+	if(!d->frames || !d->pool || !d->index) {
+		hash_error("failed to allocate memory");
+		goto FAILED;
+	}
+	for(i = 0; i < d->nframes; i++)
+		d->frames[i].data = d->pool + i * HASH_DISK_PAGE;
+	free(ovf_path);
+	return d;
+
+FAILED:
+	if(d->fd[MAIN] >= 0)
+		close(d->fd[MAIN]);
+	if(d->fd[OVF] >= 0)
+		close(d->fd[OVF]);
+	free(d->frames);
+	free(d->pool);
+	hash_free(d->index);
+	free(d);
+	free(ovf_path);
+	return NULL;
+}
+
+bool hash_disk_insert(hash_disk *d, const void *data)
+{
+	uint64_t code = disk_code(d, data), b = bucket_of(d, code);
+	uint64_t pno = b + 1;
+	int file = MAIN;
+
+	/* replace an equal element */
+	for(;;) {
+		struct frame *f = page_get(d, file, pno, false);
+		struct page_head *h;
+		size_t i;
+		if(!f) return false;
+		h = head_of(f);
+		for(i = 0; i < h->nrecs; i++) {
+			unsigned char *r = record_at(d, f, i);
+			if(memcmp(r, &code, sizeof(uint64_t)) == 0 &&
+					d->compare(r + sizeof(uint64_t), data) == 0) {
+				memcpy(r + sizeof(uint64_t), data, d->hd.data_size);
+				f->dirty = true;
+				page_put(f);
+				return true;
+			}
+		}
+		pno = h->next;
+		page_put(f);
+		if(!pno)
+			break;
+		file = OVF;
+	}
+	if(!chain_append(d, b, code, data))
+		return false;
+	d->hd.nmembs++;
+	/* the element is in; a split that failed is tried again by */
+	/* the next insert */
+	if(d->hd.nmembs > d->max_load * d->hd.nbuckets * d->per_page &&
+			!split_one(d))
+		hash_error("failed to split a bucket");
+	return true;
+}
+
+bool hash_disk_search(hash_disk *d, const void *data, void *out)
+{
+	uint64_t code = disk_code(d, data);
+	uint64_t pno = bucket_of(d, code) + 1;
+	int file = MAIN;
+
+	for(;;) {
+		struct frame *f = page_get(d, file, pno, false);
+		struct page_head *h;
+		size_t i;
+		if(!f) return false;
+		h = head_of(f);
+		for(i = 0; i < h->nrecs; i++) {
+			unsigned char *r = record_at(d, f, i);
+			if(memcmp(r, &code, sizeof(uint64_t)) == 0 &&
+					d->compare(r + sizeof(uint64_t), data) == 0) {
+				memcpy(out, r + sizeof(uint64_t), d->hd.data_size);
+				page_put(f);
+				return true;
+			}
+		}
+		pno = h->next;
+		page_put(f);
+		if(!pno)
+			return false;
+		file = OVF;
+	}
+}
+
+bool hash_disk_delete(hash_disk *d, void *data)
+{
+	uint64_t code = disk_code(d, data);
+	uint64_t pno = bucket_of(d, code) + 1, prev = 0;
+	int file = MAIN;
+
+	for(;;) {
+		struct frame *f = page_get(d, file, pno, false);
+		struct page_head *h;
+		size_t i;
+		if(!f) return false;
+		h = head_of(f);
+		for(i = 0; i < h->nrecs; i++) {
+			unsigned char *r = record_at(d, f, i);
+			if(memcmp(r, &code, sizeof(uint64_t)) != 0 ||
+					d->compare(r + sizeof(uint64_t), data) != 0)
+				continue;
+			memcpy(data, r + sizeof(uint64_t), d->hd.data_size);
+			/* the last record of the page fills the hole */
+			if(i != --h->nrecs)
+				memcpy(r, record_at(d, f, h->nrecs), d->record_size);
+			f->dirty = true;
+			/* unlink an overflow page left empty */
+			if(h->nrecs == 0 && file == OVF) {
+				struct frame *p = page_get(d, prev == 0 ? MAIN : OVF,
+						prev == 0 ? bucket_of(d, code) + 1 : prev,
+						false);
+				if(!p) {
+					page_put(f);
+					return false;
+				}
+				head_of(p)->next = h->next;
+				p->dirty = true;
+				page_put(p);
+				ovf_release(d, f, pno);
+			}
+			page_put(f);
+			d->hd.nmembs--;
+			return true;
+		}
+		if(file == OVF)
+			prev = pno;
+		pno = h->next;
+		page_put(f);
+		if(!pno)
+			return false;
+		file = OVF;
+	}
+}
+
+size_t hash_disk_nmembs(const hash_disk *d)
+{
+	return d->hd.nmembs;
+}
+
+void hash_disk_io(const hash_disk *d, size_t *reads, size_t *writes)
+{
+	if(reads)
+		*reads = d->reads;
+	if(writes)
+		*writes = d->writes;
+}
+
+bool hash_disk_sync(hash_disk *d)
+{
+	bool res = true;
+	size_t i;
+
+	for(i = 0; i < d->nframes; i++)
+		if(d->frames[i].valid && d->frames[i].dirty &&
+				!page_write(d, &d->frames[i]))
+			res = false;
+	if(pwrite(d->fd[MAIN], &d->hd, sizeof(d->hd), 0) != sizeof(d->hd)) {
+		hash_error("failed to write header");
+		res = false;
+	}
+	if(fsync(d->fd[OVF]) < 0 || fsync(d->fd[MAIN]) < 0) {
+		hash_error("failed to sync file");
+		res = false;
+	}
+	return res;
+}
+
+bool hash_disk_close(hash_disk *d)
+{
+	bool res;
+
+	if(!d) return true;
+	res = hash_disk_sync(d);
+	close(d->fd[MAIN]);
+	close(d->fd[OVF]);
+	hash_free(d->index);
+	free(d->frames);
+	free(d->pool);
+	free(d->buf);
+	free(d);
+	return res;
+}
@@ -0,0 +1,59 @@
+/* hash_disk.h defines a hash table kept in a file, for sets larger
+ * than memory.
+ *
+ * The table uses linear hashing: bucket i is page i + 1 of the file,
+ * and the table grows by splitting one bucket at a time into a new
+ * page appended to the file, so growing never rewrites more than two
+ * buckets. Records that do not fit in the page of their bucket go to
+ * overflow pages, kept in a second file named after the first with
+ * ".ovf" appended. Splits keep the load of the primary pages below
+ * max_load, so a search usually reads one page.
+ *
+ * Pages are read and written through a small buffer pool with CLOCK
+ * replacement; changes reach the files when pages are evicted, and
+ * at hash_disk_sync and hash_disk_close. A table is used by a single
+ * thread.
+ */
+
+#ifndef _HASH_DISK_H
+#define _HASH_DISK_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "hash.h"
+
+#define HASH_DISK_PAGE (4096)
+/* pages held by the buffer pool by default */
+#define HASH_DISK_FRAMES (64)
+/* split a bucket when nmembs exceeds HASH_DISK_MAX_LOAD times the */
+/* records that fit in the primary pages */
+#define HASH_DISK_MAX_LOAD (0.6)
+
+typedef struct hash_disk hash_disk;
+
+/* open the table in file h_init->path, creating it if absent */
+/* data_size, cmp_func and hash_func are used as by hash_init, and */
+/* must match those the table was created with; size is the number */
+/* of elements to make room for when creating, and max_load the */
+/* load of primary pages to split at; nframes of zero means */
+/* HASH_DISK_FRAMES. return NULL if failed */
+hash_disk *hash_disk_open(struct hash_init *h_init, size_t nframes);
+/* insert data, replacing an equal element */
+/* return false if failed */
+bool hash_disk_insert(hash_disk *d, const void *data);
+/* copy the element equal to data to out */
+/* return false if absent or failed */
+bool hash_disk_search(hash_disk *d, const void *data, void *out);
+/* delete the element equal to data, copying it to data */
+/* return false if absent or failed */
+bool hash_disk_delete(hash_disk *d, void *data);
+size_t hash_disk_nmembs(const hash_disk *d);
+/* number of pages read from and written to the files so far */
+void hash_disk_io(const hash_disk *d, size_t *reads, size_t *writes);
+/* write the dirty pages and the header */
+/* return false if failed */
+bool hash_disk_sync(hash_disk *d);
+/* sync and free d; return false if the sync failed */
+bool hash_disk_close(hash_disk *d);
+
+#endif
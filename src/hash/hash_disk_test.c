@@ -0,0 +1,180 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_disk.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#define MAXSIZE (1<<17)
+#define PATH "/tmp/hash_disk_test.db"
+#define OVF_PATH "/tmp/hash_disk_test.db.ovf"
+
+struct record {
+	int key;
+	int value;
+	char payload[56];
+};
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+int main(void)
+{
+	struct hash_init h_init;
+	struct record r;
+	hash_disk *d;
+	size_t reads, before, n;
+	static bool added[MAXSIZE / 4];
+	struct rlimit old, limit;
+	struct stat st;
+	int i;
+
+	remove(PATH);
+	remove(OVF_PATH);
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.data_size = sizeof(struct record);
+	h_init.cmp_func = compare;
+	h_init.hash_func = hash_int;
+	h_init.path = PATH;
+	/* start with a single bucket, so that every bucket is split */
+	d = hash_disk_open(&h_init, 16);
+	if(!d) {
+		fprintf(stderr, "failed to open table\n");
+		goto FAILED;
+	}
+	memset(&r, 0, sizeof(r));
+	for(i = 0; i < MAXSIZE; i++) {
+		r.key = i;
+		r.value = -i;
+		if(!hash_disk_insert(d, &r)) {
+			fprintf(stderr, "insert error\n");
+			goto FAILED;
+		}
+	}
+	/* replace every other element */
+	for(i = 0; i < MAXSIZE; i += 2) {
+		r.key = i;
+		r.value = i;
+		if(!hash_disk_insert(d, &r)) {
+			fprintf(stderr, "insert error\n");
+			goto FAILED;
+		}
+	}
+	if(hash_disk_nmembs(d) != MAXSIZE || !hash_disk_close(d)) {
+		fprintf(stderr, "insert error\n");
+		goto FAILED;
+	}
+
+	/* reopen with a cold pool: a search reads about one page */
+	d = hash_disk_open(&h_init, 16);
+	if(!d || hash_disk_nmembs(d) != MAXSIZE) {
+		fprintf(stderr, "failed to reopen table\n");
+		goto FAILED;
+	}
+	hash_disk_io(d, &before, NULL);
+	for(i = 0; i < 2 * MAXSIZE; i++) {
+		int key = (int)(((unsigned)i * 2654435761u) % (2 * MAXSIZE));
+		bool found = hash_disk_search(d, &key, &r);
+		if(found != (key < MAXSIZE) || (found && (r.key != key ||
+						r.value != (key % 2 ? -key : key)))) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+	hash_disk_io(d, &reads, NULL);
+	if((double)(reads - before) / (2 * MAXSIZE) > 1.1) {
+		fprintf(stderr, "%.2f pages read per search\n",
+				(double)(reads - before) / (2 * MAXSIZE));
+		goto FAILED;
+	}
+
+	for(i = 0; i < MAXSIZE; i += 2) {
+		r.key = i;
+		if(!hash_disk_delete(d, &r) || r.value != i) {
+			fprintf(stderr, "delete error\n");
+			goto FAILED;
+		}
+	}
+	r.key = 0;
+	if(hash_disk_delete(d, &r) || hash_disk_nmembs(d) != MAXSIZE / 2) {
+		fprintf(stderr, "delete error\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		if(hash_disk_search(d, &i, &r) != (i % 2 == 1)) {
+			fprintf(stderr, "delete error\n");
+			goto FAILED;
+		}
+	}
+	hash_disk_close(d);
+
+	/* an existing table without its overflow file is not opened */
+	remove(OVF_PATH);
+	d = hash_disk_open(&h_init, 16);
+	if(d || access(OVF_PATH, F_OK) == 0) {
+		fprintf(stderr, "opened a table without overflow file\n");
+		goto FAILED;
+	}
+	remove(PATH);
+
+	/* past a file size limit, inserts fail and splits are left */
+	/* undone, but no element is lost */
+	d = hash_disk_open(&h_init, 4);
+	for(i = 0; d && i < MAXSIZE / 16; i++) {
+		r.key = i;
+		if(!hash_disk_insert(d, &r))
+			break;
+	}
+	if(!d || i < MAXSIZE / 16 || !hash_disk_sync(d) ||
+			stat(PATH, &st) < 0 || getrlimit(RLIMIT_FSIZE, &old) < 0) {
+		fprintf(stderr, "insert error\n");
+		goto FAILED;
+	}
+	limit = old;
+	limit.rlim_cur = (rlim_t)st.st_size;
+	signal(SIGXFSZ, SIG_IGN);
+	if(setrlimit(RLIMIT_FSIZE, &limit) < 0) {
+		fprintf(stderr, "failed to limit file size\n");
+		goto FAILED;
+	}
+	/* stop once enough inserts have failed */
+	n = MAXSIZE / 16;
+	for(i = MAXSIZE / 16; i < MAXSIZE / 4 && (size_t)i - n < 64; i++) {
+		r.key = i;
+		added[i] = hash_disk_insert(d, &r);
+		n += added[i];
+	}
+	setrlimit(RLIMIT_FSIZE, &old);
+	if((size_t)i - n < 64 || hash_disk_nmembs(d) != n) {
+		fprintf(stderr, "insert error past the size limit\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE / 4; i++) {
+		if(hash_disk_search(d, &i, &r) != (i < MAXSIZE / 16 || added[i])) {
+			fprintf(stderr, "element lost past the size limit\n");
+			goto FAILED;
+		}
+	}
+	hash_disk_close(d);
+	remove(PATH);
+	remove(OVF_PATH);
+	printf("----------passed----------\n");
+	return 0;
+
+FAILED:
+	hash_disk_close(d);
+	remove(PATH);
+	remove(OVF_PATH);
+	printf("----------failed----------\n");
+	return 1;
+}
@@ -0,0 +1,122 @@
+#include "hash.h"
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Built-in hash functions. hash_bytes is wyhash (final version 4,
+ * default secrets): the input is consumed 16 or 48 bytes at a time,
+ * each step folding a 64x64->128 bit multiply of two input words
+ * xored with secrets. Words are read in native order, so the codes
+ * match the reference test vectors (checked by hash_test.c) on
+ * little-endian machines.
+ */
+
+static const uint64_t secret[4] = {
+	0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+	0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+/* multiply, leaving the low half in *a and the high half in *b */
+static void mum128(uint64_t *a, uint64_t *b)
+{
+#ifdef __SIZEOF_INT128__
+	__extension__ unsigned __int128 r = (unsigned __int128)*a * *b;
+	*a = (uint64_t)r;
+	*b = (uint64_t)(r >> 64);
+#else
+	uint64_t ha = *a >> 32, hb = *b >> 32;
+	uint64_t la = (uint32_t)*a, lb = (uint32_t)*b;
+	uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	uint64_t t = rl + (rm0 << 32), c = t < rl;
+	uint64_t lo = t + (rm1 << 32);
+	c += lo < t;
+	*a = lo;
+	*b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+/* multiply and return the xor of the high and low halves */
+static uint64_t mum(uint64_t a, uint64_t b)
+{
+	mum128(&a, &b);
+	return a ^ b;
+}
+
+static uint64_t read8(const unsigned char *p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static uint64_t read4(const unsigned char *p)
+{
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+/* hash len bytes starting at data (wyhash) */
+uint64_t hash_bytes(const void *data, size_t len, uint64_t seed)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	uint64_t a, b;
+
+	seed ^= mum(seed ^ secret[0], secret[1]);
+	if(len <= 16) {
+		if(len >= 4) {
+			size_t k = (len >> 3) << 2;
+			a = (read4(p) << 32) | read4(p + k);
+			b = (read4(p + len - 4) << 32) | read4(p + len - 4 - k);
+		} else if(len > 0) {
+			a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) |
+				p[len - 1];
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		size_t i = len;
+		if(i > 48) {
+			uint64_t see1 = seed, see2 = seed;
+			do {
+				seed = mum(read8(p) ^ secret[1],
+						read8(p + 8) ^ seed);
+				see1 = mum(read8(p + 16) ^ secret[2],
+						read8(p + 24) ^ see1);
+				see2 = mum(read8(p + 32) ^ secret[3],
+						read8(p + 40) ^ see2);
+				p += 48;
+				i -= 48;
+			} while(i > 48);
+			seed ^= see1 ^ see2;
+		}
+		while(i > 16) {
+			seed = mum(read8(p) ^ secret[1], read8(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = read8(p + i - 16);
+		b = read8(p + i - 8);
+	}
+	a ^= secret[1];
+	b ^= seed;
+	mum128(&a, &b);
+	return mum(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+/* hash_func for data beginning with an int */
+uint64_t hash_int(const void *data)
+{
+	int key;
+	memcpy(&key, data, sizeof(key));
+	return hash_mix64((uint64_t)(unsigned int)key);
+}
+
+/* hash_func for data beginning with a uint64_t */
+uint64_t hash_uint64(const void *data)
+{
+	uint64_t key;
+	memcpy(&key, data, sizeof(key));
+	return hash_mix64(key);
+}
@@ -0,0 +1,192 @@
+/* hash_gen.h generates hash tables specialized for a key type and a
+ * value type, with the hash and equality functions inlined.
+ *
+ *     static inline uint64_t int_hash(int k) { return (uint64_t)k; }
+ *     #define int_eq(a, b) ((a) == (b))
+ *     HASH_GEN(imap, int, long, int_hash, int_eq)
+ *
+ * defines imap_t and static functions imap_init, imap_free,
+ * imap_find, imap_put, imap_delete and imap_clear. hash_fn(key)
+ * returns a uint64_t, which is mixed with hash_mix64, and eq_fn(a, b)
+ * is nonzero when two keys are equal; either may be a macro.
+ *
+ * Keys, values and slot flags are kept in three arrays, probed
+ * linearly, and deletion shifts the following keys back so there are
+ * no tombstones. A slot index i is in use when used[i] is nonzero,
+ * and stays valid until the next put or delete:
+ *
+ *     for(i = 0; i < h->capacity; i++)
+ *         if(h->used[i]) ... h->keys[i], h->vals[i] ...
+ *
+ * Nothing here needs libhash; hash structures of any type stay the
+ * generic alternative.
+ */
+
+#ifndef _HASH_GEN_H
+#define _HASH_GEN_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "hash.h"
+
+/* grow when more than 3/4 of the slots are in use */
+#define HASH_GEN_MAX_LOAD(capacity) ((capacity) / 4 * 3)
+
+#define HASH_GEN(name, key_t, val_t, hash_fn, eq_fn)			\
+typedef struct {							\
+	size_t capacity;						\
+	size_t nmembs;							\
+	unsigned char *used;						\
+	key_t *keys;							\
+	val_t *vals;							\
+} name##_t;								\
+									\
+static inline size_t name##_home(const name##_t *h, key_t key)		\
+{									\
+	return (size_t)hash_mix64(hash_fn(key)) & (h->capacity - 1);	\
+}									\
+									\
+/* allocate arrays of given capacity, a power of two */			\
+static inline bool name##_alloc(name##_t *h, size_t capacity)		\
+{									\
+	h->used = (unsigned char *)calloc(capacity, 1);			\
+	h->keys = (key_t *)malloc(capacity * sizeof(key_t));		\
+	h->vals = (val_t *)malloc(capacity * sizeof(val_t));		\
+	if(!h->used || !h->keys || !h->vals) {				\
+		free(h->used);						\
+		free(h->keys);						\
+		free(h->vals);						\
+		return false;						\
+	}								\
+	h->capacity = capacity;						\
+	return true;							\
+}									\
+									\
+/* allocate a table for about size elements; zero means default */	\
+static inline name##_t *name##_init(size_t size)			\
+{									\
+	name##_t *h = (name##_t *)malloc(sizeof(name##_t));		\
+	size_t capacity = 4;						\
+	if(!h) return NULL;						\
+	if(!size)							\
+		size = HASH_INIT_SIZE;					\
+	while(HASH_GEN_MAX_LOAD(capacity) < size)			\
+		capacity *= 2;						\
+	if(!name##_alloc(h, capacity)) {				\
+		free(h);						\
+		return NULL;						\
+	}								\
+	h->nmembs = 0;							\
+	return h;							\
+}									\
+									\
+static inline void name##_free(name##_t *h)				\
+{									\
+	if(!h) return;							\
+	free(h->used);							\
+	free(h->keys);							\
+	free(h->vals);							\
+	free(h);							\
+}									\
+									\
+static inline void name##_clear(name##_t *h)				\
+{									\
+	memset(h->used, 0, h->capacity);				\
+	h->nmembs = 0;							\
+}									\
+									\
+/* return the slot of key, or capacity if absent */			\
+static inline size_t name##_find(const name##_t *h, key_t key)		\
+{									\
+	size_t mask = h->capacity - 1;					\
+	size_t i = name##_home(h, key);					\
+	while(h->used[i]) {						\
+		if(eq_fn(h->keys[i], key))				\
+			return i;					\
+		i = (i + 1) & mask;					\
+	}								\
+	return h->capacity;						\
+}									\
+									\
+/* move all elements into arrays of given capacity */			\
+static inline bool name##_resize(name##_t *h, size_t capacity)		\
+{									\
+	name##_t old = *h;						\
+	size_t i;							\
+	if(!name##_alloc(h, capacity)) {				\
+		*h = old;						\
+		return false;						\
+	}								\
+	for(i = 0; i < old.capacity; i++) {				\
+		size_t j;						\
+		if(!old.used[i])					\
+			continue;					\
+		j = name##_home(h, old.keys[i]);			\
+		while(h->used[j])					\
+			j = (j + 1) & (capacity - 1);			\
+		h->used[j] = 1;						\
+		h->keys[j] = old.keys[i];				\
+		h->vals[j] = old.vals[i];				\
+	}								\
+	free(old.used);							\
+	free(old.keys);							\
+	free(old.vals);							\
+	return true;							\
+}									\
+									\
+/* return the slot of key, adding it with a zeroed value if absent; */	\
+/* *inserted tells which happened. return capacity if failed */	\
+static inline size_t name##_put(name##_t *h, key_t key, bool *inserted)	\
+{									\
+	size_t mask = h->capacity - 1;					\
+	size_t i = name##_home(h, key);					\
+	while(h->used[i]) {						\
+		if(eq_fn(h->keys[i], key)) {				\
+			if(inserted)					\
+				*inserted = false;			\
+			return i;					\
+		}							\
+		i = (i + 1) & mask;					\
+	}								\
+	if(h->nmembs + 1 > HASH_GEN_MAX_LOAD(h->capacity)) {		\
+		if(!name##_resize(h, h->capacity * 2))			\
+			return h->capacity;				\
+		mask = h->capacity - 1;					\
+		i = name##_home(h, key);				\
+		while(h->used[i])					\
+			i = (i + 1) & mask;				\
+	}								\
+	h->used[i] = 1;							\
+	h->keys[i] = key;						\
+	memset(&h->vals[i], 0, sizeof(val_t));				\
+	h->nmembs++;							\
+	if(inserted)							\
+		*inserted = true;					\
+	return i;							\
+}									\
+									\
+/* delete key; return false if absent */				\
+static inline bool name##_delete(name##_t *h, key_t key)		\
+{									\
+	size_t mask = h->capacity - 1;					\
+	size_t i = name##_find(h, key), j;				\
+	if(i == h->capacity)						\
+		return false;						\
+	/* move back each following key whose home slot is not */	\
+	/* cyclically in (i, j], until an empty slot */			\
+	for(j = (i + 1) & mask; h->used[j]; j = (j + 1) & mask) {	\
+		size_t k = name##_home(h, h->keys[j]);			\
+		if(i <= j ? (i < k && k <= j) : (i < k || k <= j))	\
+			continue;					\
+		h->keys[i] = h->keys[j];				\
+		h->vals[i] = h->vals[j];				\
+		i = j;							\
+	}								\
+	h->used[i] = 0;							\
+	h->nmembs--;							\
+	return true;							\
+}
+
+#endif
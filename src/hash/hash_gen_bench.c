@@ -0,0 +1,106 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash.h"
+#include "hash_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Insert and search throughput of a table generated by HASH_GEN for
+ * uint64_t keys, against the generic HASH_CHAINED and HASH_SWISS
+ * tables calling hash_uint64 and compare through pointers.
+ */
+
+#define NKEYS (1<<20)
+
+#define u64_eq(a, b) ((a) == (b))
+#define u64_hash(k) (k)
+
+HASH_GEN(u64set, uint64_t, char, u64_hash, u64_eq)
+
+int compare(const void *x, const void *y)
+{
+	const uint64_t *a = (uint64_t *)x;
+	const uint64_t *b = (uint64_t *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+double now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void report(const char *name, double insert, double search)
+{
+	printf("%-12s insert %8.2f Mops/s   search %8.2f Mops/s\n", name,
+			NKEYS / insert / 1e6, 2 * NKEYS / search / 1e6);
+}
+
+int main(void)
+{
+	struct hash_init h_init;
+	uint64_t *keys = malloc(2 * NKEYS * sizeof(uint64_t));
+	size_t i, found, expect = 0;
+	double start, insert, search;
+	int type;
+
+	if(!keys) {
+		fprintf(stderr, "failed to allocate memory\n");
+		exit(EXIT_FAILURE);
+	}
+	srand(1);
+	for(i = 0; i < 2 * NKEYS; i++)
+		keys[i] = ((uint64_t)rand() << 31) ^ (uint64_t)rand();
+
+	u64set_t *s = u64set_init(0);
+	if(!s) {
+		fprintf(stderr, "failed to initialize hash\n");
+		exit(EXIT_FAILURE);
+	}
+	start = now();
+	for(i = 0; i < NKEYS; i++)
+		u64set_put(s, keys[i], NULL);
+	insert = now() - start;
+	start = now();
+	for(i = 0; i < 2 * NKEYS; i++)
+		expect += u64set_find(s, keys[i]) != s->capacity;
+	search = now() - start;
+	report("HASH_GEN", insert, search);
+	u64set_free(s);
+
+	for(type = HASH_CHAINED; type <= HASH_SWISS; type++) {
+		memset(&h_init, 0, sizeof(h_init));
+		h_init.type = type;
+		h_init.data_size = sizeof(uint64_t);
+		h_init.cmp_func = compare;
+		h_init.hash_func = hash_uint64;
+		hash *h = hash_init(&h_init);
+		if(!h) {
+			fprintf(stderr, "failed to initialize hash\n");
+			exit(EXIT_FAILURE);
+		}
+		start = now();
+		for(i = 0; i < NKEYS; i++)
+			hash_insert(h, &keys[i]);
+		insert = now() - start;
+		start = now();
+		found = 0;
+		for(i = 0; i < 2 * NKEYS; i++)
+			found += hash_search(h, &keys[i]) != NULL;
+		search = now() - start;
+		if(found != expect) {
+			fprintf(stderr, "search error\n");
+			exit(EXIT_FAILURE);
+		}
+		report(type == HASH_CHAINED ? "HASH_CHAINED" : "HASH_SWISS",
+				insert, search);
+		hash_free(h);
+	}
+	free(keys);
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,99 @@
+#include "hash_gen.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <string.h>
+
+#define MAXSIZE (1<<20)
+#define int_eq(a, b) ((a) == (b))
+#define int_hash(k) ((uint64_t)(k))
+
+HASH_GEN(imap, int, long, int_hash, int_eq)
+
+int main(void)
+{
+	imap_t *h;
+	int i, tmp;
+	size_t k;
+	bool inserted;
+
+	h = imap_init(16);
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	char tested[MAXSIZE];
+
+	memset(tested, 0, MAXSIZE);
+	for(i = 0; i < MAXSIZE; i++) {
+		k = imap_put(h, i, &inserted);
+		if(k == h->capacity || !inserted || h->vals[k] != 0) {
+			fprintf(stderr, "put error\n");
+			goto FAILED;
+		}
+		h->vals[k] = -(long)i;
+	}
+	for(i = 0; i < MAXSIZE; i += 2) {
+		k = imap_put(h, i, &inserted);
+		if(k == h->capacity || inserted || h->vals[k] != -(long)i) {
+			fprintf(stderr, "put error\n");
+			goto FAILED;
+		}
+	}
+	if(h->nmembs != MAXSIZE) {
+		fprintf(stderr, "put error\n");
+		goto FAILED;
+	}
+
+	srand((unsigned int)time(0));
+	for(i = 0; i < MAXSIZE / 2; i++) {
+		tmp = (int)rand() % MAXSIZE;
+		if(imap_delete(h, tmp) == tested[tmp]) {
+			fprintf(stderr, "delete error\n");
+			goto FAILED;
+		}
+		tested[tmp] = 1;
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		k = imap_find(h, i);
+		if((k == h->capacity) != tested[i] ||
+				(k != h->capacity && h->vals[k] != -(long)i)) {
+			fprintf(stderr, "find error\n");
+			goto FAILED;
+		}
+	}
+	for(i = MAXSIZE; i < 2 * MAXSIZE; i++) {
+		if(imap_find(h, i) != h->capacity) {
+			fprintf(stderr, "find error\n");
+			goto FAILED;
+		}
+	}
+
+	/* every slot in use holds a key not deleted */
+	size_t count = 0;
+	for(k = 0; k < h->capacity; k++) {
+		if(!h->used[k])
+			continue;
+		if(tested[h->keys[k]]) {
+			fprintf(stderr, "iteration error\n");
+			goto FAILED;
+		}
+		count++;
+	}
+	if(count != h->nmembs) {
+		fprintf(stderr, "iteration error\n");
+		goto FAILED;
+	}
+	imap_clear(h);
+	if(h->nmembs != 0 || imap_find(h, 1) != h->capacity) {
+		fprintf(stderr, "clear error\n");
+		goto FAILED;
+	}
+	imap_free(h);
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
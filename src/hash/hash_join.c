@@ -0,0 +1,477 @@
+#include "hash_join.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ *    keys --> codes --> partition 0: | ctrl | keys | rows |
+ *                       partition 1: | ctrl | keys | rows |
+ *                       ...
+ *
+ * The upper bits of the code of a key pick its partition, the middle
+ * bits its first group of 16 slots, and the low 7 bits are its tag,
+ * stored in the control byte of its slot; empty slots have the high
+ * bit set. Groups are probed in triangular order until one with an
+ * empty slot, and no slot is ever freed, so equal keys simply sit in
+ * several slots. Each table is at most 7/8 full.
+ */
+
+#define GROUP_SIZE 16
+#define CTRL_EMPTY ((unsigned char)0x80)
+/* bytes of a slot of a join table: control byte, key and row */
+#define SLOT_BYTES (1 + sizeof(uint64_t) + sizeof(uint32_t))
+/* probes issued ahead of the one being done */
+#define PREFETCH_DISTANCE 16
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct part {
+	unsigned char *ctrl;
+	uint64_t *keys;
+	uint32_t *rows;
+	/* number of groups minus one */
+	size_t mask;
+};
+
+struct join_table {
+	struct part *parts;
+	size_t nparts;
+	/* 64 - log2(nparts), 64 meaning a single partition */
+	int shift;
+};
+
+struct group_table {
+	unsigned char *ctrl;
+	struct group_row *rows;
+	size_t mask;
+	size_t nmembs;
+	/* number of empty slots that may still be filled */
+	size_t growth_left;
+};
+
+/* bit i set if ctrl[i] == c */
+static unsigned int group_match(const unsigned char *ctrl, unsigned char c)
+{
+#ifdef __SSE2__
+	__m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+	return (unsigned int)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+#else
+	unsigned int mask = 0;
+	int i;
+	for(i = 0; i < GROUP_SIZE; i++)
+		if(ctrl[i] == c)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+/* bit i set if ctrl[i] is EMPTY */
+static unsigned int group_match_empty(const unsigned char *ctrl)
+{
+#ifdef __SSE2__
+	__m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+	return (unsigned int)_mm_movemask_epi8(g);
+#else
+	unsigned int mask = 0;
+	int i;
+	for(i = 0; i < GROUP_SIZE; i++)
+		if(ctrl[i] & 0x80)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+/* number of groups holding n keys at a load of at most 7/8 */
+static size_t groups_for(size_t n)
+{
+	size_t ngroups = 1;
+	while(ngroups * GROUP_SIZE - ngroups * GROUP_SIZE / 8 < n)
+		ngroups *= 2;
+	return ngroups;
+}
+
+/* hash all keys of a batch in one loop */
+static void batch_codes(const uint64_t *keys, size_t n, uint64_t *codes)
+{
+	size_t i;
+	for(i = 0; i < n; i++)
+		codes[i] = hash_mix64(keys[i]);
+}
+
+static size_t part_of(const join_table *t, uint64_t code)
+{
+	return t->shift == 64 ? 0 : (size_t)(code >> t->shift);
+}
+
+static bool part_alloc(struct part *p, size_t n)
+{
+	size_t cap = groups_for(n) * GROUP_SIZE;
+
+	p->ctrl = (unsigned char *)malloc(cap);
+	p->keys = (uint64_t *)malloc(cap * sizeof(uint64_t));
+	p->rows = (uint32_t *)malloc(cap * sizeof(uint32_t));
+	if(!p->ctrl || !p->keys || !p->rows)
+		return false;
+	memset(p->ctrl, CTRL_EMPTY, cap);
+	p->mask = cap / GROUP_SIZE - 1;
+	return true;
+}
+
+static void part_insert(struct part *p, uint64_t code, uint64_t key,
+		uint32_t row)
+{
+	size_t g = (size_t)(code >> 7) & p->mask, step = 0;
+
+	for(;;) {
+		unsigned int m = group_match_empty(p->ctrl + g * GROUP_SIZE);
+		if(m) {
+			size_t i = g * GROUP_SIZE + __builtin_ctz(m);
+			p->ctrl[i] = (unsigned char)(code & 0x7f);
+			p->keys[i] = key;
+			p->rows[i] = row;
+			return;
+		}
+		g = (g + ++step) & p->mask;
+	}
+}
+
+join_table *join_build(const uint64_t *keys, size_t n)
+{
+	if(n > UINT32_MAX) {
+		hash_error("too many rows");
+		return NULL;
+	}
+	join_table *t = (join_table *)calloc(1, sizeof(join_table));
+	uint64_t *codes = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+	uint64_t *pcodes = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+	uint64_t *pkeys = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+	uint32_t *prows = (uint32_t *)malloc((n + 1) * sizeof(uint32_t));
+	size_t *start = NULL;
+	size_t nparts = 1, i, p;
+	int shift = 64;
+
+	if(!t || !codes || !pcodes || !pkeys || !prows) {
+		hash_error("failed to allocate memory");
+		goto FAILED;
+	}
+	while(nparts * JOIN_PART_BYTES < n * SLOT_BYTES) {
+		nparts *= 2;
+		shift--;
+	}
+	t->nparts = nparts;
+	t->shift = shift;
+	t->parts = (struct part *)calloc(nparts, sizeof(struct part));
+	start = (size_t *)calloc(nparts + 1, sizeof(size_t));
+	if(!t->parts || !start) {
+		hash_error("failed to allocate memory");
+		goto FAILED;
+	}
+
+	/* scatter the rows to their partitions, with their codes */
+	batch_codes(keys, n, codes);
+	for(i = 0; i < n; i++)
+		start[part_of(t, codes[i]) + 1]++;
+	for(p = 0; p < nparts; p++)
+		start[p + 1] += start[p];
+	for(i = 0; i < n; i++) {
+		size_t j = start[part_of(t, codes[i])]++;
+		pcodes[j] = codes[i];
+		pkeys[j] = keys[i];
+		prows[j] = (uint32_t)i;
+	}
+	memmove(start + 1, start, nparts * sizeof(size_t));
+	start[0] = 0;
+
+	/* and fill one partition at a time */
+	for(p = 0; p < nparts; p++) {
+		if(!part_alloc(&t->parts[p], start[p + 1] - start[p])) {
+			hash_error("failed to allocate memory");
+			goto FAILED;
+		}
+		for(i = start[p]; i < start[p + 1]; i++)
+			part_insert(&t->parts[p], pcodes[i], pkeys[i], prows[i]);
+	}
+	free(codes);
+	free(pcodes);
+	free(pkeys);
+	free(prows);
+	free(start);
+	return t;
+
+FAILED:
+	free(codes);
+	free(pcodes);
+	free(pkeys);
+	free(prows);
+	free(start);
+	join_free(t);
+	return NULL;
+}
+
+static bool result_add(struct join_result *res, uint32_t build, uint32_t probe)
+{
+	if(res->n == res->cap) {
+		size_t cap = res->cap ? res->cap * 2 : JOIN_BATCH;
+		uint32_t *b = (uint32_t *)realloc(res->build,
+				cap * sizeof(uint32_t));
+		uint32_t *p;
+		if(!b) return false;
+		res->build = b;
+		p = (uint32_t *)realloc(res->probe, cap * sizeof(uint32_t));
+		if(!p) return false;
+		res->probe = p;
+		res->cap = cap;
+	}
+	res->build[res->n] = build;
+	res->probe[res->n] = probe;
+	res->n++;
+	return true;
+}
+
+static void prefetch_probe(const join_table *t, uint64_t code)
+{
+	const struct part *p = &t->parts[part_of(t, code)];
+	size_t g = (size_t)(code >> 7) & p->mask;
+	__builtin_prefetch(p->ctrl + g * GROUP_SIZE);
+	__builtin_prefetch(p->keys + g * GROUP_SIZE);
+}
+
+bool join_probe(const join_table *t, const uint64_t *keys, size_t n,
+		uint32_t first_row, struct join_result *res)
+{
+	uint64_t codes[JOIN_BATCH];
+	size_t base, i;
+
+	for(base = 0; base < n; base += JOIN_BATCH) {
+		size_t len = n - base < JOIN_BATCH ? n - base : JOIN_BATCH;
+		batch_codes(keys + base, len, codes);
+		for(i = 0; i < len && i < PREFETCH_DISTANCE; i++)
+			prefetch_probe(t, codes[i]);
+		for(i = 0; i < len; i++) {
+			const struct part *p = &t->parts[part_of(t, codes[i])];
+			size_t g = (size_t)(codes[i] >> 7) & p->mask, step = 0;
+			unsigned char tag = (unsigned char)(codes[i] & 0x7f);
+			uint64_t key = keys[base + i];
+
+			if(i + PREFETCH_DISTANCE < len)
+				prefetch_probe(t, codes[i + PREFETCH_DISTANCE]);
+			for(;;) {
+				const unsigned char *ctrl = p->ctrl + g * GROUP_SIZE;
+				unsigned int m = group_match(ctrl, tag);
+				while(m) {
+					size_t s = g * GROUP_SIZE + __builtin_ctz(m);
+					if(p->keys[s] == key && !result_add(res,
+								p->rows[s],
+								first_row +
+								(uint32_t)(base + i))) {
+						hash_error("failed to allocate memory");
+						return false;
+					}
+					m &= m - 1;
+				}
+				if(group_match_empty(ctrl))
+					break;
+				g = (g + ++step) & p->mask;
+			}
+		}
+	}
+	return true;
+}
+
+void join_result_free(struct join_result *res)
+{
+	if(!res) return;
+	free(res->build);
+	free(res->probe);
+	memset(res, 0, sizeof(struct join_result));
+}
+
+void join_free(join_table *t)
+{
+	size_t i;
+
+	if(!t) return;
+	if(t->parts) {
+		for(i = 0; i < t->nparts; i++) {
+			free(t->parts[i].ctrl);
+			free(t->parts[i].keys);
+			free(t->parts[i].rows);
+		}
+	}
+	free(t->parts);
+	free(t);
+}
+
+/* allocate empty arrays of ngroups groups */
+static bool group_alloc(group_table *g, size_t ngroups)
+{
+	size_t cap = ngroups * GROUP_SIZE;
+	unsigned char *ctrl = (unsigned char *)malloc(cap);
+	struct group_row *rows = (struct group_row *)
+		malloc(cap * sizeof(struct group_row));
+
+	if(!ctrl || !rows) {
+		free(ctrl);
+		free(rows);
+		return false;
+	}
+	memset(ctrl, CTRL_EMPTY, cap);
+	g->ctrl = ctrl;
+	g->rows = rows;
+	g->mask = ngroups - 1;
+	g->growth_left = cap - cap / 8 - g->nmembs;
+	return true;
+}
+
+group_table *group_init(size_t size)
+{
+	group_table *g = (group_table *)malloc(sizeof(group_table));
+
+	if(!g) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	g->nmembs = 0;
+	if(!group_alloc(g, groups_for(size ? size : HASH_INIT_SIZE))) {
+		hash_error("failed to allocate memory");
+		free(g);
+		return NULL;
+	}
+	return g;
+}
+
+/* return the slot of key, or the empty slot ending its probe */
+static size_t group_slot(const group_table *g, uint64_t code, uint64_t key)
+{
+	size_t i = (size_t)(code >> 7) & g->mask, step = 0;
+	unsigned char tag = (unsigned char)(code & 0x7f);
+
+	for(;;) {
+		const unsigned char *ctrl = g->ctrl + i * GROUP_SIZE;
+		unsigned int m = group_match(ctrl, tag);
+		while(m) {
+			size_t s = i * GROUP_SIZE + __builtin_ctz(m);
+			if(g->rows[s].key == key)
+				return s;
+			m &= m - 1;
+		}
+		m = group_match_empty(ctrl);
+		if(m)
+			return i * GROUP_SIZE + __builtin_ctz(m);
+		i = (i + ++step) & g->mask;
+	}
+}
+
+/* move all rows to a table of twice the size */
+static bool group_grow(group_table *g)
+{
+	unsigned char *ctrl = g->ctrl;
+	struct group_row *rows = g->rows;
+	size_t cap = (g->mask + 1) * GROUP_SIZE, i;
+
+	if(!group_alloc(g, (g->mask + 1) * 2))
+		return false;
+	for(i = 0; i < cap; i++) {
+		uint64_t code;
+		size_t s;
+		if(ctrl[i] & CTRL_EMPTY)
+			continue;
+		code = hash_mix64(rows[i].key);
+		s = group_slot(g, code, rows[i].key);
+		g->ctrl[s] = ctrl[i];
+		g->rows[s] = rows[i];
+	}
+	free(ctrl);
+	free(rows);
+	return true;
+}
+
+bool group_add(group_table *g, const uint64_t *keys, const int64_t *values,
+		size_t n)
+{
+	uint64_t codes[JOIN_BATCH];
+	size_t base, i;
+
+	for(base = 0; base < n; base += JOIN_BATCH) {
+		size_t len = n - base < JOIN_BATCH ? n - base : JOIN_BATCH;
+		batch_codes(keys + base, len, codes);
+		for(i = 0; i < len; i++) {
+			uint64_t key = keys[base + i];
+			int64_t v = values[base + i];
+			struct group_row *r;
+			size_t s;
+
+			if(i + PREFETCH_DISTANCE < len) {
+				size_t k = (size_t)(codes[i + PREFETCH_DISTANCE] >> 7) &
+					g->mask;
+				__builtin_prefetch(g->ctrl + k * GROUP_SIZE);
+			}
+			s = group_slot(g, codes[i], key);
+			if(g->ctrl[s] & CTRL_EMPTY) {
+				if(!g->growth_left) {
+					if(!group_grow(g)) {
+						hash_error("failed to allocate memory");
+						return false;
+					}
+					s = group_slot(g, codes[i], key);
+				}
+				g->ctrl[s] = (unsigned char)(codes[i] & 0x7f);
+				r = &g->rows[s];
+				r->key = key;
+				r->count = 0;
+				r->sum = 0;
+				r->min = INT64_MAX;
+				r->max = INT64_MIN;
+				g->nmembs++;
+				g->growth_left--;
+			}
+			r = &g->rows[s];
+			r->count++;
+			/* wrap around as unsigned instead of overflowing */
+			r->sum = (int64_t)((uint64_t)r->sum + (uint64_t)v);
+			if(v < r->min)
+				r->min = v;
+			if(v > r->max)
+				r->max = v;
+		}
+	}
+	return true;
+}
+
+const struct group_row *group_find(const group_table *g, uint64_t key)
+{
+	size_t s = group_slot(g, hash_mix64(key), key);
+	return g->ctrl[s] & CTRL_EMPTY ? NULL : &g->rows[s];
+}
+
+const struct group_row *group_next(const group_table *g, size_t *pos)
+{
+	size_t cap = (g->mask + 1) * GROUP_SIZE;
+
+	while(*pos < cap) {
+		size_t i = (*pos)++;
+		if(!(g->ctrl[i] & CTRL_EMPTY))
+			return &g->rows[i];
+	}
+	return NULL;
+}
+
+size_t group_nmembs(const group_table *g)
+{
+	return g->nmembs;
+}
+
+void group_free(group_table *g)
+{
+	if(!g) return;
+	free(g->ctrl);
+	free(g->rows);
+	free(g);
+}
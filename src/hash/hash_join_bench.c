@@ -0,0 +1,156 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash.h"
+#include "hash_join.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Join and group-by throughput of the column operators of hash_join.h
+ * against a row-at-a-time HASH_CHAINED map, inserting, searching and
+ * updating one row per call through hash_func and cmp_func.
+ */
+
+#define NBUILD (1<<20)
+#define NPROBE (1<<22)
+#define NGROUPS (1<<16)
+
+struct row {
+	uint64_t key;
+	uint32_t row;
+};
+
+struct agg {
+	uint64_t count;
+	int64_t sum;
+	int64_t min;
+	int64_t max;
+};
+
+int compare(const void *x, const void *y)
+{
+	const uint64_t *a = (uint64_t *)x;
+	const uint64_t *b = (uint64_t *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+void aggregate(void *value, bool inserted, void *arg)
+{
+	struct agg *a = (struct agg *)value;
+	int64_t v = *(int64_t *)arg;
+	if(inserted) {
+		a->min = v;
+		a->max = v;
+	}
+	a->count++;
+	a->sum += v;
+	if(v < a->min)
+		a->min = v;
+	if(v > a->max)
+		a->max = v;
+}
+
+double now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+	uint64_t *build = malloc(NBUILD * sizeof(uint64_t));
+	uint64_t *probe = malloc(NPROBE * sizeof(uint64_t));
+	uint64_t *gkeys = malloc(NPROBE * sizeof(uint64_t));
+	int64_t *values = malloc(NPROBE * sizeof(int64_t));
+	struct join_result res;
+	struct hash_init h_init;
+	join_table *t;
+	group_table *g;
+	hash *h;
+	size_t i, found;
+	double start, row_build, row_probe, col_build, col_probe;
+	double row_group, col_group;
+
+	if(!build || !probe || !gkeys || !values) {
+		fprintf(stderr, "failed to allocate memory\n");
+		exit(EXIT_FAILURE);
+	}
+	srand(1);
+	/* distinct build keys, and probe keys half of which match */
+	for(i = 0; i < NBUILD; i++)
+		build[i] = hash_mix64(i);
+	for(i = 0; i < NPROBE; i++) {
+		size_t k = (size_t)rand() % (2 * NBUILD);
+		probe[i] = k < NBUILD ? build[k] : hash_mix64(k);
+		gkeys[i] = (uint64_t)rand() % NGROUPS;
+		values[i] = rand() % 1000;
+	}
+
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.key_size = sizeof(uint64_t);
+	h_init.value_size = sizeof(uint32_t);
+	h_init.cmp_func = compare;
+	h_init.hash_func = hash_uint64;
+	start = now();
+	h = hash_init(&h_init);
+	for(i = 0; h && i < NBUILD; i++) {
+		struct row r = { build[i], (uint32_t)i };
+		hash_insert(h, &r);
+	}
+	row_build = now() - start;
+	start = now();
+	found = 0;
+	for(i = 0; h && i < NPROBE; i++)
+		found += hash_search(h, &probe[i]) != NULL;
+	row_probe = now() - start;
+	hash_free(h);
+
+	memset(&res, 0, sizeof(res));
+	start = now();
+	t = join_build(build, NBUILD);
+	col_build = now() - start;
+	start = now();
+	if(!t || !join_probe(t, probe, NPROBE, 0, &res) || res.n != found) {
+		fprintf(stderr, "join error\n");
+		exit(EXIT_FAILURE);
+	}
+	col_probe = now() - start;
+	join_result_free(&res);
+	join_free(t);
+
+	h_init.value_size = sizeof(struct agg);
+	start = now();
+	h = hash_init(&h_init);
+	for(i = 0; h && i < NPROBE; i++)
+		hash_update(h, &gkeys[i], aggregate, &values[i]);
+	row_group = now() - start;
+	found = h ? h->nmembs : 0;
+	hash_free(h);
+
+	start = now();
+	g = group_init(0);
+	if(!g || !group_add(g, gkeys, values, NPROBE) ||
+			group_nmembs(g) != found) {
+		fprintf(stderr, "group error\n");
+		exit(EXIT_FAILURE);
+	}
+	col_group = now() - start;
+	group_free(g);
+
+	printf("%-8s %12s %12s %12s\n", "", "build", "probe", "group-by");
+	printf("%-8s %8.2f M/s %8.2f M/s %8.2f M/s\n", "hash",
+			NBUILD / row_build / 1e6, NPROBE / row_probe / 1e6,
+			NPROBE / row_group / 1e6);
+	printf("%-8s %8.2f M/s %8.2f M/s %8.2f M/s\n", "column",
+			NBUILD / col_build / 1e6, NPROBE / col_probe / 1e6,
+			NPROBE / col_group / 1e6);
+	free(build);
+	free(probe);
+	free(gkeys);
+	free(values);
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,116 @@
+#include "hash_join.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define NBUILD (1<<18)
+#define NPROBE (1<<19)
+#define NGROUPS 1000
+
+int main(void)
+{
+	uint64_t *build = malloc(NBUILD * sizeof(uint64_t));
+	uint64_t *probe = malloc(NPROBE * sizeof(uint64_t));
+	int64_t *values = malloc(NPROBE * sizeof(int64_t));
+	struct join_result res;
+	const struct group_row *r;
+	join_table *t = NULL;
+	group_table *g = NULL;
+	size_t i, n, pos;
+
+	memset(&res, 0, sizeof(res));
+	if(!build || !probe || !values) {
+		fprintf(stderr, "failed to allocate memory\n");
+		goto FAILED;
+	}
+	/* build keys 0, 0, 1, 1, ...: every key of the build side twice */
+	for(i = 0; i < NBUILD; i++)
+		build[i] = i / 2;
+	t = join_build(build, NBUILD);
+	if(!t) {
+		fprintf(stderr, "build error\n");
+		goto FAILED;
+	}
+	/* half of the probe keys are beyond the build keys */
+	for(i = 0; i < NPROBE; i++)
+		probe[i] = (i * 7919) % NBUILD;
+	/* probe in two calls; row ids go on from the first */
+	if(!join_probe(t, probe, NPROBE / 2 + 3, 0, &res) ||
+			!join_probe(t, probe + NPROBE / 2 + 3, NPROBE / 2 - 3,
+				NPROBE / 2 + 3, &res)) {
+		fprintf(stderr, "probe error\n");
+		goto FAILED;
+	}
+	for(i = 0, n = 0; i < NPROBE; i++)
+		n += probe[i] < NBUILD / 2 ? 2 : 0;
+	if(res.n != n) {
+		fprintf(stderr, "probe error\n");
+		goto FAILED;
+	}
+	for(i = 0; i < res.n; i++) {
+		if(res.build[i] >= NBUILD || res.probe[i] >= NPROBE ||
+				build[res.build[i]] != probe[res.probe[i]]) {
+			fprintf(stderr, "probe error\n");
+			goto FAILED;
+		}
+	}
+	join_result_free(&res);
+	join_free(t);
+	t = NULL;
+
+	/* an empty build side matches nothing */
+	t = join_build(build, 0);
+	if(!t || !join_probe(t, probe, NPROBE, 0, &res) || res.n != 0) {
+		fprintf(stderr, "probe error\n");
+		goto FAILED;
+	}
+	join_free(t);
+	t = NULL;
+
+	/* group i % NGROUPS gets the values -i */
+	g = group_init(16);
+	if(!g) {
+		fprintf(stderr, "failed to initialize group table\n");
+		goto FAILED;
+	}
+	for(i = 0; i < NPROBE; i++) {
+		probe[i] = i % NGROUPS;
+		values[i] = -(int64_t)i;
+	}
+	if(!group_add(g, probe, values, NPROBE) || group_nmembs(g) != NGROUPS) {
+		fprintf(stderr, "group error\n");
+		goto FAILED;
+	}
+	for(pos = 0, n = 0; (r = group_next(g, &pos)) != NULL; n++) {
+		uint64_t k = r->key, cnt = (NPROBE - k + NGROUPS - 1) / NGROUPS;
+		int64_t last = -(int64_t)(k + (cnt - 1) * NGROUPS);
+		if(r != group_find(g, k) || r->count != cnt || r->max != -(int64_t)k ||
+				r->min != last || r->sum != (last - (int64_t)k) *
+				(int64_t)cnt / 2) {
+			fprintf(stderr, "group error\n");
+			goto FAILED;
+		}
+	}
+	if(n != NGROUPS || group_find(g, NGROUPS) != NULL) {
+		fprintf(stderr, "group error\n");
+		goto FAILED;
+	}
+	group_free(g);
+	free(build);
+	free(probe);
+	free(values);
+	printf("----------passed----------\n");
+	return 0;
+
+FAILED:
+	join_result_free(&res);
+	join_free(t);
+	group_free(g);
+	free(build);
+	free(probe);
+	free(values);
+	printf("----------failed----------\n");
+	return 1;
+}
@@ -0,0 +1,98 @@
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define MAXSIZE (1<<18)
+#define NKEYS 1000
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+void add(void *value, bool inserted, void *arg)
+{
+	(void)inserted;
+	*(long *)value += *(long *)arg;
+}
+
+int main(void)
+{
+	hash *h;
+	int i, type;
+	long one = 1, *v;
+	bool inserted;
+	struct hash_init h_init;
+
+	for(type = HASH_CHAINED; type <= HASH_CUCKOO; type++) {
+		memset(&h_init, 0, sizeof(h_init));
+		h_init.type = type;
+		h_init.size = 16;
+		h_init.key_size = sizeof(int);
+		h_init.value_size = sizeof(long);
+		h_init.cmp_func = compare;
+		h = hash_init(&h_init);
+		if(!h || h->value_offset % sizeof(long) != 0) {
+			fprintf(stderr, "failed to initialize hash\n");
+			goto FAILED;
+		}
+
+		/* count keys i % NKEYS */
+		for(i = 0; i < MAXSIZE; i++) {
+			int key = i % NKEYS;
+			if(!hash_update(h, &key, add, &one)) {
+				fprintf(stderr, "update error\n");
+				goto FAILED;
+			}
+		}
+		if(h->nmembs != NKEYS) {
+			fprintf(stderr, "update error\n");
+			goto FAILED;
+		}
+		for(i = 0; i < NKEYS; i++) {
+			long count = MAXSIZE / NKEYS + (i < MAXSIZE % NKEYS);
+			void *data = hash_search(h, &i);
+			if(!data || *(long *)hash_value(h, data) != count) {
+				fprintf(stderr, "update error\n");
+				goto FAILED;
+			}
+		}
+
+		for(i = 0; i < 2 * NKEYS; i++) {
+			v = (long *)hash_get_or_insert(h, &i, &inserted);
+			if(!v || inserted != (i >= NKEYS) ||
+					(inserted && *v != 0)) {
+				fprintf(stderr, "get_or_insert error\n");
+				goto FAILED;
+			}
+			long value = -i;
+			if(!hash_upsert(h, &i, &value)) {
+				fprintf(stderr, "upsert error\n");
+				goto FAILED;
+			}
+		}
+		for(i = 0; i < 2 * NKEYS; i++) {
+			v = (long *)hash_get_or_insert(h, &i, &inserted);
+			if(!v || inserted || *v != -i) {
+				fprintf(stderr, "upsert error\n");
+				goto FAILED;
+			}
+		}
+		if(h->nmembs != 2 * NKEYS) {
+			fprintf(stderr, "upsert error\n");
+			goto FAILED;
+		}
+		hash_free(h);
+	}
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
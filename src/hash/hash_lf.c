@@ -0,0 +1,297 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_lf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/*
+ *    table --> +--+
+ *              |  | --> node --> node --> NULL
+ *              +--+
+ *              |  | --> NULL
+ *              +--+
+ *
+ * Readers load table, a bucket and each next pointer with acquire
+ * semantics, pairing with the release stores writers use to link a
+ * fully initialized node. A deleted node keeps its next pointer, so a
+ * reader standing on it still reaches the rest of the chain. Resizing
+ * builds a new table with copies of all nodes, publishes it, and
+ * retires the old table together with its nodes.
+ */
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define LOAD(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+#define PUBLISH(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+struct lf_node {
+	struct lf_node *next;
+	uint64_t code;
+	struct epoch_entry retire;
+	unsigned char data[];
+};
+
+struct lf_table {
+	size_t size;
+	struct epoch_entry retire;
+	struct lf_node *buckets[];
+};
+
+struct lf_hash {
+	struct lf_table *table;
+	cmp_func compare;
+	hash_func hash;
+	size_t data_size;
+	double max_load;
+	struct epoch *epoch;
+	pthread_mutex_t lock;
+	size_t nmembs;
+};
+
+/* 2^64 divided by the golden ratio */
+#define FIB_FACTOR 0x9e3779b97f4a7c15ULL
+
+static size_t lf_index(const struct lf_table *t, uint64_t code)
+{
+	return (size_t)((code * FIB_FACTOR) >> (64 - __builtin_ctzll(t->size)));
+}
+
+static uint64_t lf_code(const lf_hash *h, const void *data)
+{
+	return h->hash ? h->hash(data) : hash_bytes(data, h->data_size, 0);
+}
+
+static void free_node(struct epoch_entry *e)
+{
+	free(container_of(e, struct lf_node, retire));
+}
+
+/* free a table replaced by a resize, with the nodes only it links */
+static void free_table(struct epoch_entry *e)
+{
+	struct lf_table *t = container_of(e, struct lf_table, retire);
+	size_t i;
+
+	for(i = 0; i < t->size; i++) {
+		struct lf_node *x = t->buckets[i];
+		while(x != NULL) {
+			struct lf_node *next = x->next;
+			free(x);
+			x = next;
+		}
+	}
+	free(t);
+}
+
+static struct lf_table *new_table(size_t size)
+{
+	struct lf_table *t = (struct lf_table *)calloc(1,
+			sizeof(struct lf_table) + size * sizeof(struct lf_node *));
+	if(!t) return NULL;
+	t->size = size;
+	t->retire.free = free_table;
+	return t;
+}
+
+static struct lf_node *new_node(lf_hash *h, const void *data,
+		uint64_t code, struct lf_node *next)
+{
+	struct lf_node *node = (struct lf_node *)
+		malloc(sizeof(struct lf_node) + h->data_size);
+	if(!node) return NULL;
+	memcpy(node->data, data, h->data_size);
+	node->code = code;
+	node->next = next;
+	node->retire.free = free_node;
+	return node;
+}
+
+/* replace the table by one of double size; called with lock held */
+static void lf_grow(lf_hash *h)
+{
+	struct lf_table *old = h->table;
+	struct lf_table *t = new_table(old->size * 2);
+	size_t i;
+
+	if(!t) return;
+	for(i = 0; i < old->size; i++) {
+		struct lf_node *x;
+		for(x = old->buckets[i]; x != NULL; x = x->next) {
+			size_t index = lf_index(t, x->code);
+			struct lf_node *node = new_node(h, x->data, x->code,
+					t->buckets[index]);
+			if(!node) {
+				free_table(&t->retire);
+				return;
+			}
+			t->buckets[index] = node;
+		}
+	}
+	PUBLISH(h->table, t);
+	epoch_retire(h->epoch, &old->retire);
+}
+
+lf_hash *lf_init(struct hash_init *h_init)
+{
+	if(!h_init) {
+		hash_error("incorrect hash_init structure");
+		return NULL;
+	}
+	lf_hash *h = (lf_hash *)malloc(sizeof(lf_hash));
+	size_t size = 2;
+
+	if(!h) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	while(size < (h_init->size ? h_init->size : HASH_INIT_SIZE))
+		size *= 2;
+	h->table = new_table(size);
+	h->epoch = epoch_init();
+	if(!h->table || !h->epoch || pthread_mutex_init(&h->lock, NULL)) {
+		hash_error("failed to initialize hash");
+		free(h->table);
+		epoch_free(h->epoch);
+		free(h);
+		return NULL;
+	}
+	h->compare = h_init->cmp_func;
+	h->hash = h_init->hash_func;
+	h->data_size = h_init->data_size;
+	h->max_load = h_init->max_load > 0 ? h_init->max_load : HASH_MAX_LOAD;
+	h->nmembs = 0;
+	return h;
+}
+
+struct epoch_record *lf_register(lf_hash *h)
+{
+	if(!h) return NULL;
+	return epoch_register(h->epoch);
+}
+
+void lf_unregister(lf_hash *h, struct epoch_record *r)
+{
+	if(!h) return;
+	epoch_unregister(h->epoch, r);
+}
+
+bool lf_insert(lf_hash *h, const void *data)
+{
+	if(!h) return false;
+	uint64_t code = lf_code(h, data);
+	bool res = true;
+
+	pthread_mutex_lock(&h->lock);
+	struct lf_table *t = h->table;
+	struct lf_node **prev = &t->buckets[lf_index(t, code)];
+	struct lf_node *x = *prev;
+	while(x != NULL) {
+		if(x->code == code && h->compare(x->data, data) == 0)
+			break;
+		prev = &x->next;
+		x = x->next;
+	}
+	if(x != NULL) {
+		/* readers may be copying x, so swap in a new node */
+		struct lf_node *node = new_node(h, data, code, x->next);
+		if(node) {
+			PUBLISH(*prev, node);
+			epoch_retire(h->epoch, &x->retire);
+		}
+		res = node != NULL;
+	} else {
+		prev = &t->buckets[lf_index(t, code)];
+		struct lf_node *node = new_node(h, data, code, *prev);
+		if(node) {
+			PUBLISH(*prev, node);
+			if(++h->nmembs > h->max_load * t->size)
+				lf_grow(h);
+		}
+		res = node != NULL;
+	}
+	pthread_mutex_unlock(&h->lock);
+	if(!res)
+		hash_error("failed to allocate memory");
+	return res;
+}
+
+bool lf_delete(lf_hash *h, void *data)
+{
+	if(!h) return false;
+	uint64_t code = lf_code(h, data);
+
+	pthread_mutex_lock(&h->lock);
+	struct lf_table *t = h->table;
+	struct lf_node **prev = &t->buckets[lf_index(t, code)];
+	struct lf_node *x = *prev;
+	while(x != NULL) {
+		if(x->code == code && h->compare(x->data, data) == 0) {
+			PUBLISH(*prev, x->next);
+			memcpy(data, x->data, h->data_size);
+			h->nmembs--;
+			epoch_retire(h->epoch, &x->retire);
+			pthread_mutex_unlock(&h->lock);
+			return true;
+		}
+		prev = &x->next;
+		x = x->next;
+	}
+	pthread_mutex_unlock(&h->lock);
+	return false;
+}
+
+const void *lf_lookup(lf_hash *h, const void *data)
+{
+	if(!h) return NULL;
+	uint64_t code = lf_code(h, data);
+	struct lf_table *t = LOAD(h->table);
+	struct lf_node *x = LOAD(t->buckets[lf_index(t, code)]);
+
+	while(x != NULL) {
+		if(x->code == code && h->compare(x->data, data) == 0)
+			return x->data;
+		x = LOAD(x->next);
+	}
+	return NULL;
+}
+
+bool lf_search(lf_hash *h, struct epoch_record *r,
+		const void *data, void *out)
+{
+	if(!h || !r) return false;
+	const void *found;
+
+	epoch_enter(r);
+	found = lf_lookup(h, data);
+	if(found && out)
+		memcpy(out, found, h->data_size);
+	epoch_exit(r);
+	return found != NULL;
+}
+
+size_t lf_nmembs(lf_hash *h)
+{
+	if(!h) return 0;
+	size_t n;
+
+	pthread_mutex_lock(&h->lock);
+	n = h->nmembs;
+	pthread_mutex_unlock(&h->lock);
+	return n;
+}
+
+void lf_free(lf_hash *h)
+{
+	if(!h) return;
+	epoch_free(h->epoch);
+	free_table(&h->table->retire);
+	pthread_mutex_destroy(&h->lock);
+	free(h);
+}
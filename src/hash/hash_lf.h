@@ -0,0 +1,45 @@
+/* hash_lf.h defines a hash table with lock-free searches.
+ *
+ * Writers are serialized by a mutex and publish nodes with release
+ * stores; readers take no lock and write nothing shared. Unlinked
+ * nodes, and whole bucket arrays replaced by a resize, are reclaimed
+ * through an epoch manager (see epoch.h) once no reader can see them.
+ *
+ * Every reading thread needs its own record from lf_register. Either
+ * call lf_search, which copies the element out, or bracket lf_lookup
+ * and the use of its result with epoch_enter/epoch_exit.
+ */
+
+#ifndef _HASH_LF_H
+#define _HASH_LF_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include "hash.h"
+#include "epoch.h"
+
+typedef struct lf_hash lf_hash;
+
+/* allocate a table configured by h_init; type, min_load and */
+/* rehash_step are ignored, and a resize copies the table at once */
+lf_hash *lf_init(struct hash_init *h_init);
+/* get and give back the record of a reading thread */
+struct epoch_record *lf_register(lf_hash *h);
+void lf_unregister(lf_hash *h, struct epoch_record *r);
+/* insert data, replacing an equal element */
+bool lf_insert(lf_hash *h, const void *data);
+/* delete data, copying the deleted element back to data */
+bool lf_delete(lf_hash *h, void *data);
+/* search data and copy the element found to out if out is not NULL */
+/* return true if found */
+bool lf_search(lf_hash *h, struct epoch_record *r,
+		const void *data, void *out);
+/* search data from inside epoch_enter/epoch_exit; the pointer */
+/* returned is valid until epoch_exit */
+const void *lf_lookup(lf_hash *h, const void *data);
+/* number of elements */
+size_t lf_nmembs(lf_hash *h);
+/* free the table; no thread may use it any more */
+void lf_free(lf_hash *h);
+
+#endif
@@ -0,0 +1,113 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_lf.h"
+#include "hash_shard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/*
+ * Read-mostly throughput of lf_hash against shard_hash: every thread
+ * performs OPS operations on random keys, one in WRITE_RATE of them
+ * an insert and the rest searches.
+ */
+
+#define NKEYS (1<<20)
+#define OPS (1<<21)
+#define WRITE_RATE 100
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+lf_hash *lf;
+shard_hash *sh;
+
+void *lf_worker(void *arg)
+{
+	unsigned int seed = (unsigned int)(long)arg;
+	struct epoch_record *r = lf_register(lf);
+	long i, found = 0;
+	int key;
+
+	for(i = 0; i < OPS; i++) {
+		key = rand_r(&seed) % NKEYS;
+		if(i % WRITE_RATE == 0)
+			lf_insert(lf, &key);
+		else
+			found += lf_search(lf, r, &key, NULL);
+	}
+	lf_unregister(lf, r);
+	return (void *)found;
+}
+
+void *shard_worker(void *arg)
+{
+	unsigned int seed = (unsigned int)(long)arg;
+	long i, found = 0;
+	int key;
+
+	for(i = 0; i < OPS; i++) {
+		key = rand_r(&seed) % NKEYS;
+		if(i % WRITE_RATE == 0)
+			shard_insert(sh, &key);
+		else
+			found += shard_search(sh, &key, NULL);
+	}
+	return (void *)found;
+}
+
+double run(void *(*worker)(void *), int nthreads)
+{
+	pthread_t threads[nthreads];
+	struct timespec start, end;
+	long i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(i = 0; i < nthreads; i++)
+		pthread_create(&threads[i], NULL, worker, (void *)(i + 1));
+	for(i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+	return (double)OPS * nthreads / secs / 1e6;
+}
+
+int main(void)
+{
+	struct hash_init h_init;
+	int i, nthreads, ncpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.size = NKEYS;
+	h_init.data_size = sizeof(int);
+	h_init.cmp_func = compare;
+	h_init.hash_func = hash_int;
+	lf = lf_init(&h_init);
+	sh = shard_init(&h_init, 0);
+	if(!lf || !sh) {
+		fprintf(stderr, "failed to initialize hash\n");
+		exit(EXIT_FAILURE);
+	}
+	for(i = 0; i < NKEYS; i += 2) {
+		lf_insert(lf, &i);
+		shard_insert(sh, &i);
+	}
+
+	printf("threads  lf_hash(Mops/s)  shard_hash(Mops/s)\n");
+	for(nthreads = 1; nthreads <= ncpus; nthreads *= 2)
+		printf("%7d  %15.2f  %18.2f\n", nthreads,
+				run(lf_worker, nthreads), run(shard_worker, nthreads));
+	lf_free(lf);
+	shard_free(sh);
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,144 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_lf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NREADERS 6
+#define NWRITERS 2
+#define NKEYS (1<<14)
+#define ROUNDS 20
+
+struct item {
+	int key;
+	int value;
+};
+
+int compare(const void *x, const void *y)
+{
+	const struct item *a = (struct item *)x;
+	const struct item *b = (struct item *)y;
+	if(a->key > b->key) return 1;
+	else if(a->key == b->key) return 0;
+	return -1;
+}
+
+lf_hash *h;
+int done;
+
+/* keys [NKEYS, 2 * NKEYS) are always present; */
+/* keys below NKEYS come and go, with value 3 * key or 5 * key */
+void *reader(void *arg)
+{
+	struct epoch_record *r = lf_register(h);
+	unsigned int seed = (unsigned int)(long)arg;
+	struct item x, out;
+	long bad = 0;
+
+	if(!r) return (void *)1;
+	while(!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+		x.key = rand_r(&seed) % (2 * NKEYS);
+		if(lf_search(h, r, &x, &out)) {
+			if(out.key != x.key || (out.value != 3 * x.key &&
+						out.value != 5 * x.key))
+				bad++;
+		} else if(x.key >= NKEYS) {
+			bad++;
+		}
+	}
+	lf_unregister(h, r);
+	return (void *)bad;
+}
+
+/* writer w owns keys congruent to w modulo NWRITERS */
+void *writer(void *arg)
+{
+	int w = (int)(long)arg;
+	struct item x;
+	int round, key;
+
+	for(round = 0; round < ROUNDS; round++) {
+		for(key = w; key < NKEYS; key += NWRITERS) {
+			x.key = key;
+			x.value = (round % 2 ? 5 : 3) * key;
+			if(!lf_insert(h, &x))
+				return (void *)1;
+		}
+		for(key = w; key < NKEYS; key += 2 * NWRITERS) {
+			x.key = key;
+			if(!lf_delete(h, &x) || x.key != key)
+				return (void *)1;
+		}
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t readers[NREADERS], writers[NWRITERS];
+	struct hash_init h_init;
+	struct epoch_record *r;
+	struct item x;
+	long i;
+	void *res;
+
+	memset(&h_init, 0, sizeof(h_init));
+	/* small, so that the table is replaced while readers run */
+	h_init.size = 16;
+	h_init.data_size = sizeof(struct item);
+	h_init.cmp_func = compare;
+	h_init.hash_func = hash_int;
+	h = lf_init(&h_init);
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	for(i = NKEYS; i < 2 * NKEYS; i++) {
+		x.key = (int)i;
+		x.value = 3 * (int)i;
+		lf_insert(h, &x);
+	}
+
+	for(i = 0; i < NREADERS; i++)
+		pthread_create(&readers[i], NULL, reader, (void *)(i + 1));
+	for(i = 0; i < NWRITERS; i++)
+		pthread_create(&writers[i], NULL, writer, (void *)i);
+	for(i = 0; i < NWRITERS; i++) {
+		pthread_join(writers[i], &res);
+		if(res) {
+			fprintf(stderr, "writer error\n");
+			goto FAILED;
+		}
+	}
+	__atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+	for(i = 0; i < NREADERS; i++) {
+		pthread_join(readers[i], &res);
+		if(res) {
+			fprintf(stderr, "reader saw %ld bad results\n", (long)res);
+			goto FAILED;
+		}
+	}
+
+	/* half of the transient keys survive the last round */
+	if(lf_nmembs(h) != NKEYS + NKEYS / 2) {
+		fprintf(stderr, "nmembs error\n");
+		goto FAILED;
+	}
+	r = lf_register(h);
+	for(i = 0; i < NKEYS; i++) {
+		x.key = (int)i;
+		if(lf_search(h, r, &x, &x) != (i % (2 * NWRITERS) >= NWRITERS)) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+	lf_unregister(h, r);
+	lf_free(h);
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
@@ -0,0 +1,350 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ *    +--------+-----------------------+----------------------------+
+ *    | header | index[0..nbuckets]    | records, in bucket order   |
+ *    +--------+-----------------------+----------------------------+
+ *                  |          |          ^          ^
+ *                  +----------|----------+          |
+ *                             +---------------------+
+ *
+ * A snapshot holds no pointers: the records of bucket i are
+ * index[i] .. index[i + 1] - 1, each one the 64-bit hash code
+ * followed by the data, padded to 8 bytes. The file can be mapped
+ * read-only at any address and searched at once; pages are read by
+ * the kernel as they are touched, and processes mapping the same
+ * file share them. Integers are stored in native byte order.
+ */
+
+#define SNAP_MAGIC 0x50414e5348534148ULL	/* "HASHSNAP" */
+#define SNAP_VERSION 1
+
+/* 2^64 divided by the golden ratio */
+#define FIB_FACTOR 0x9e3779b97f4a7c15ULL
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct snap_header {
+	uint64_t magic;
+	uint64_t version;
+	uint64_t data_size;
+	uint64_t record_size;
+	uint64_t nbuckets;
+	uint64_t nmembs;
+};
+
+struct mapped {
+	void *base;
+	size_t length;
+	const struct snap_header *header;
+	const uint64_t *index;
+	const unsigned char *records;
+	int shift;
+};
+
+static bool mapped_init(hash *h, struct hash_init *h_init);
+static bool mapped_insert(hash *h, const void *data);
+static bool mapped_delete(hash *h, void *data);
+static void *mapped_search(hash *h, const void *data);
+static void mapped_free(hash *h);
+static void mapped_stats(hash *h, struct hash_stats *st);
+static void *mapped_next(hash *h, struct hash_iter *it);
+
+const struct hash_ops hash_mapped_ops = {
+	mapped_init,
+	mapped_insert,
+	mapped_delete,
+	mapped_search,
+	mapped_free,
+	mapped_stats,
+	mapped_next,
+	NULL,
+};
+
+static size_t record_size(size_t data_size)
+{
+	return (sizeof(uint64_t) + data_size + 7) & ~(size_t)7;
+}
+
+static size_t snap_index(uint64_t code, int shift)
+{
+	return (size_t)((code * FIB_FACTOR) >> shift);
+}
+
+/* call fn on every node of a chained table */
+static void chain_walk(hash *h, void (*fn)(hash_list *, void *), void *arg)
+{
+	hash_slot *tables[2] = { h->table, h->old_table };
+	size_t sizes[2] = { h->size, h->old_size };
+	size_t i;
+	int k;
+
+	for(k = 0; k < 2; k++) {
+		if(!tables[k])
+			continue;
+		for(i = 0; i < sizes[k]; i++) {
+			hash_list *x;
+			for(x = tables[k][i].next; x != NULL; x = x->next)
+				fn(x, arg);
+		}
+	}
+}
+
+struct snap_build {
+	uint64_t *index;
+	unsigned char *records;
+	size_t record_size;
+	size_t data_size;
+	int shift;
+};
+
+static void count_node(hash_list *x, void *arg)
+{
+	struct snap_build *b = (struct snap_build *)arg;
+	b->index[snap_index(x->code, b->shift) + 1]++;
+}
+
+static void place_node(hash_list *x, void *arg)
+{
+	struct snap_build *b = (struct snap_build *)arg;
+	unsigned char *r = b->records +
+		b->index[snap_index(x->code, b->shift)]++ * b->record_size;
+	memcpy(r, &x->code, sizeof(uint64_t));
+	memcpy(r + sizeof(uint64_t), x->data, b->data_size);
+}
+
+/* write the contents of a HASH_CHAINED table to a file that */
+/* hash_map can map back; return true if written successfully */
+bool hash_save(hash *h, const char *path)
+{
+	if(!h || !path) return false;
+	if(h->ops) {
+		hash_error("only chained tables can be saved");
+		return false;
+	}
+	struct snap_header header;
+	struct snap_build b;
+	size_t nbuckets = 2, i;
+	int shift = 63;
+	bool res = false;
+	FILE *fp;
+
+	while(nbuckets < h->nmembs) {
+		nbuckets *= 2;
+		shift--;
+	}
+	b.record_size = record_size(h->data_size);
+	b.data_size = h->data_size;
+	b.shift = shift;
+	b.index = (uint64_t *)calloc(nbuckets + 1, sizeof(uint64_t));
+	b.records = (unsigned char *)calloc(h->nmembs ? h->nmembs : 1,
+			b.record_size);
+	if(!b.index || !b.records) {
+		hash_error("failed to allocate memory");
+		goto OUT;
+	}
+	/* counting sort of the nodes by bucket */
+	chain_walk(h, count_node, &b);
+	for(i = 0; i < nbuckets; i++)
+		b.index[i + 1] += b.index[i];
+	chain_walk(h, place_node, &b);
+	/* place_node moved each start to the next bucket's start */
+	memmove(b.index + 1, b.index, nbuckets * sizeof(uint64_t));
+	b.index[0] = 0;
+
+	header.magic = SNAP_MAGIC;
+	header.version = SNAP_VERSION;
+	header.data_size = h->data_size;
+	header.record_size = b.record_size;
+	header.nbuckets = nbuckets;
+	header.nmembs = h->nmembs;
+	fp = fopen(path, "wb");
+	if(!fp) {
+		hash_error("failed to open file");
+		goto OUT;
+	}
+	res = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+		fwrite(b.index, sizeof(uint64_t), nbuckets + 1, fp) ==
+			nbuckets + 1 &&
+		fwrite(b.records, b.record_size, h->nmembs, fp) == h->nmembs;
+	if(fclose(fp) != 0)
+		res = false;
+	if(!res)
+		hash_error("failed to write file");
+OUT:
+	free(b.index);
+	free(b.records);
+	return res;
+}
+
+/* check that a mapping of length bytes is a well formed snapshot, */
+/* before any pointer past the header is formed from it: a corrupt */
+/* or truncated file would have searches read past the mapping */
+static bool snap_valid(const void *base, size_t length)
+{
+	const struct snap_header *hd = (const struct snap_header *)base;
+	const uint64_t *index = (const uint64_t *)(hd + 1);
+	size_t avail = length - sizeof(struct snap_header);
+	uint64_t i;
+
+	if(hd->magic != SNAP_MAGIC || hd->version != SNAP_VERSION)
+		return false;
+	/* hash_save writes at least two buckets, a power of two */
+	if(hd->nbuckets < 2 || (hd->nbuckets & (hd->nbuckets - 1)) ||
+			avail < sizeof(uint64_t) ||
+			hd->nbuckets + 1 > avail / sizeof(uint64_t))
+		return false;
+	avail -= (hd->nbuckets + 1) * sizeof(uint64_t);
+	if(hd->data_size > avail || hd->record_size !=
+			record_size((size_t)hd->data_size) ||
+			hd->nmembs > avail / hd->record_size ||
+			hd->nmembs * hd->record_size != avail)
+		return false;
+	/* bucket i is index[i] .. index[i + 1] - 1 within the records */
+	if(index[0] != 0 || index[hd->nbuckets] != hd->nmembs)
+		return false;
+	for(i = 0; i < hd->nbuckets; i++)
+		if(index[i] > index[i + 1])
+			return false;
+	return true;
+}
+
+/* map a file written by hash_save as a read-only HASH_MAPPED table, */
+/* using the callbacks in h_init, which must match the saved table */
+/* return NULL if failed */
+hash *hash_map(const char *path, struct hash_init *h_init)
+{
+	if(!path || !h_init) {
+		hash_error("incorrect hash_init structure");
+		return NULL;
+	}
+	struct hash_init init = *h_init;
+	init.type = HASH_MAPPED;
+	init.path = path;
+	return hash_init(&init);
+}
+
+bool mapped_init(hash *h, struct hash_init *h_init)
+{
+	struct mapped *m = (struct mapped *)malloc(sizeof(struct mapped));
+	struct stat st;
+	int fd;
+
+	if(!m || !h_init->path) {
+		free(m);
+		return false;
+	}
+	fd = open(h_init->path, O_RDONLY);
+	if(fd < 0 || fstat(fd, &st) < 0 ||
+			(size_t)st.st_size < sizeof(struct snap_header)) {
+		hash_error("failed to open snapshot");
+		if(fd >= 0)
+			close(fd);
+		free(m);
+		return false;
+	}
+	m->length = (size_t)st.st_size;
+	m->base = mmap(NULL, m->length, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(m->base == MAP_FAILED) {
+		hash_error("failed to map snapshot");
+		free(m);
+		return false;
+	}
+	m->header = (const struct snap_header *)m->base;
+	if(!snap_valid(m->base, m->length) ||
+			(h->data_size && h->data_size != m->header->data_size)) {
+		hash_error("incorrect snapshot");
+		munmap(m->base, m->length);
+		free(m);
+		return false;
+	}
+	m->index = (const uint64_t *)(m->header + 1);
+	m->records = (const unsigned char *)(m->index +
+			m->header->nbuckets + 1);
+	m->shift = 64 - __builtin_ctzll(m->header->nbuckets);
+	h->data_size = m->header->data_size;
+	h->size = m->header->nbuckets;
+	h->nmembs = m->header->nmembs;
+	h->engine = m;
+	return true;
+}
+
+bool mapped_insert(hash *h, const void *data)
+{
+	(void)h;
+	(void)data;
+	hash_error("mapped table is read-only");
+	return false;
+}
+
+bool mapped_delete(hash *h, void *data)
+{
+	(void)h;
+	(void)data;
+	hash_error("mapped table is read-only");
+	return false;
+}
+
+void *mapped_search(hash *h, const void *data)
+{
+	struct mapped *m = (struct mapped *)h->engine;
+	uint64_t code = hash_code(h, data);
+	size_t i = snap_index(code, m->shift);
+	uint64_t k;
+
+	for(k = m->index[i]; k < m->index[i + 1]; k++) {
+		const unsigned char *r = m->records + k * m->header->record_size;
+		uint64_t c;
+		memcpy(&c, r, sizeof(uint64_t));
+		if(c == code && hash_cmp(h, r + sizeof(uint64_t), data) == 0) {
+			HASH_STAT(hash_count_lookup(h, true,
+						k - m->index[i] + 1));
+			return (void *)(r + sizeof(uint64_t));
+		}
+	}
+	HASH_STAT(hash_count_lookup(h, false, k - m->index[i]));
+	return NULL;
+}
+
+void mapped_free(hash *h)
+{
+	struct mapped *m = (struct mapped *)h->engine;
+	munmap(m->base, m->length);
+	free(m);
+}
+
+void mapped_stats(hash *h, struct hash_stats *st)
+{
+	struct mapped *m = (struct mapped *)h->engine;
+	size_t i;
+
+	/* the mapping is counted whole, though only touched pages */
+	/* are resident */
+	st->bytes += sizeof(struct mapped) + m->length;
+	for(i = 0; i < m->header->nbuckets; i++) {
+		size_t n = (size_t)(m->index[i + 1] - m->index[i]);
+		if(n > st->max_chain)
+			st->max_chain = n;
+		st->hist[n < HASH_HIST_SIZE ? n : HASH_HIST_SIZE - 1]++;
+	}
+}
+
+void *mapped_next(hash *h, struct hash_iter *it)
+{
+	struct mapped *m = (struct mapped *)h->engine;
+	if(it->pos >= m->header->nmembs)
+		return NULL;
+	return (void *)(m->records +
+			it->pos++ * m->header->record_size + sizeof(uint64_t));
+}
@@ -0,0 +1,192 @@
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAXSIZE (1<<20)
+#define SNAPSHOT "hash_mmap_test.snap"
+#define CORRUPT "hash_mmap_test.bad"
+/* header fields, as 64-bit words */
+#define NBUCKETS 4
+#define NMEMBS 5
+#define RECORD_SIZE 3
+#define HEADER_BYTES (6 * 8)
+
+struct item {
+	int key;
+	int value;
+};
+
+int compare(const void *x, const void *y)
+{
+	const struct item *a = (struct item *)x;
+	const struct item *b = (struct item *)y;
+	if(a->key > b->key) return 1;
+	else if(a->key == b->key) return 0;
+	return -1;
+}
+
+/* copy SNAPSHOT to CORRUPT, setting word at to value unless at is */
+/* negative, and truncating the copy by cut bytes, or to -cut bytes */
+/* if cut is negative */
+bool corrupt(long at, uint64_t value, long cut)
+{
+	FILE *in = fopen(SNAPSHOT, "rb"), *out = fopen(CORRUPT, "wb");
+	unsigned char buf[1 << 16];
+	size_t n, len = 0, total;
+	bool res = in && out;
+
+	if(res) {
+		fseek(in, 0, SEEK_END);
+		total = cut < 0 ? (size_t)-cut : (size_t)ftell(in) - (size_t)cut;
+		rewind(in);
+		while(len < total && (n = fread(buf, 1, sizeof(buf), in)) > 0) {
+			if(n > total - len)
+				n = total - len;
+			res = res && fwrite(buf, 1, n, out) == n;
+			len += n;
+		}
+		if(at >= 0) {
+			fseek(out, at * (long)sizeof(uint64_t), SEEK_SET);
+			res = res && fwrite(&value, sizeof(value), 1, out) == 1;
+		}
+	}
+	if(in)
+		fclose(in);
+	if(out && fclose(out) != 0)
+		res = false;
+	return res;
+}
+
+/* set word at of CORRUPT to value */
+bool patch(long at, uint64_t value)
+{
+	FILE *f = fopen(CORRUPT, "r+b");
+	bool res = f && fseek(f, at * (long)sizeof(uint64_t), SEEK_SET) == 0 &&
+		fwrite(&value, sizeof(value), 1, f) == 1;
+
+	if(f && fclose(f) != 0)
+		res = false;
+	return res;
+}
+
+int main(void)
+{
+	hash *h, *m;
+	int i;
+	struct item x, *p;
+	struct hash_init h_init;
+
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.size = 16;
+	h_init.data_size = sizeof(struct item);
+	h_init.cmp_func = compare;
+	h_init.hash_func = hash_int;
+	h = hash_init(&h_init);
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	/* even keys only; the table may be saved in the middle of a resize */
+	for(i = 0; i < MAXSIZE; i += 2) {
+		x.key = i;
+		x.value = -i;
+		hash_insert(h, &x);
+	}
+	if(!hash_save(h, SNAPSHOT)) {
+		fprintf(stderr, "save error\n");
+		goto FAILED;
+	}
+	hash_free(h);
+
+	m = hash_map(SNAPSHOT, &h_init);
+	if(!m || m->nmembs != MAXSIZE / 2) {
+		fprintf(stderr, "map error\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		x.key = i;
+		p = hash_search(m, &x);
+		if(i % 2 ? p != NULL : p == NULL || p->value != -i) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+	/* the mapped table is read-only */
+	x.key = 0;
+	if(hash_insert(m, &x) || hash_delete(m, &x)) {
+		fprintf(stderr, "read-only error\n");
+		goto FAILED;
+	}
+	hash_free(m);
+
+	/* corrupt or truncated snapshots are refused */
+	struct {
+		long at;
+		uint64_t value;
+		long cut;
+	} bad[] = {
+		{ -1, 0, 1 },
+		{ -1, 0, sizeof(struct item) + 8 },
+		{ NBUCKETS, 0, 0 },
+		{ NBUCKETS, 1, 0 },
+		{ NBUCKETS, 3 << 10, 0 },
+		{ NBUCKETS, (uint64_t)1 << 62, 0 },
+		{ NMEMBS, MAXSIZE / 2 + 1, 0 },
+		{ NMEMBS, (uint64_t)1 << 61, 0 },
+		{ RECORD_SIZE, 8, 0 },
+		{ RECORD_SIZE, 0, 0 },
+		/* a header only, with two buckets and no index, and */
+		/* with less than one index word or only one */
+		{ NBUCKETS, 2, -HEADER_BYTES },
+		{ NBUCKETS, 2, -(HEADER_BYTES + 4) },
+		{ NBUCKETS, 2, -(HEADER_BYTES + 8) },
+		{ -1, 0, -HEADER_BYTES },
+		/* index[0] and index[1] of the saved table */
+		{ 6, 1, 0 },
+		{ 7, MAXSIZE, 0 },
+	};
+	h_init.data_size = 0;
+	for(i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++) {
+		if(!corrupt(bad[i].at, bad[i].value, bad[i].cut)) {
+			fprintf(stderr, "write error\n");
+			goto FAILED;
+		}
+		m = hash_map(CORRUPT, &h_init);
+		if(m) {
+			fprintf(stderr, "corrupt snapshot %d mapped\n", i);
+			hash_free(m);
+			goto FAILED;
+		}
+	}
+	/* a header only, whose sizes wrap around to match its length */
+	if(!corrupt(NBUCKETS, 1 << 20, -HEADER_BYTES) || !patch(2, 0) ||
+			!patch(RECORD_SIZE, 8) ||
+			!patch(NMEMBS, ((uint64_t)1 << 61) - (1 << 20) - 1)) {
+		fprintf(stderr, "write error\n");
+		goto FAILED;
+	}
+	m = hash_map(CORRUPT, &h_init);
+	if(m) {
+		fprintf(stderr, "corrupt snapshot mapped\n");
+		hash_free(m);
+		goto FAILED;
+	}
+	/* an untouched copy still maps */
+	if(!corrupt(-1, 0, 0) || !(m = hash_map(CORRUPT, &h_init))) {
+		fprintf(stderr, "map error\n");
+		goto FAILED;
+	}
+	hash_free(m);
+	unlink(CORRUPT);
+	unlink(SNAPSHOT);
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	unlink(CORRUPT);
+	unlink(SNAPSHOT);
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
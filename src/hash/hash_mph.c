@@ -0,0 +1,461 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_mph.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ *    +--------+-------------------+--------------------+-------------+
+ *    | header | pilot[nbuckets]   | remap[nslots - n]  | slot[n]     |
+ *    +--------+-------------------+--------------------+-------------+
+ *
+ * The code of a key, mixed with the seed, picks a bucket, and the
+ * upper half of code ^ mix(pilot[bucket]), scaled to nslots, picks
+ * its slot. The builder places buckets from the largest down, trying
+ * pilots until every key of the bucket lands on a free slot, as CHD
+ * and PTHash do; a skewed choice of buckets makes the large ones come
+ * while the table is still empty.
+ * A little slack, nslots = n + n / 64 + 1, keeps the last buckets
+ * from needing long searches; the few keys landing at or past n are
+ * moved to the holes below n through remap. Each part is padded to 8
+ * bytes, and integers are in native byte order, as in hash_save.
+ */
+
+#define MPH_MAGIC 0x0048504d48534148ULL	/* "HASHMPH" */
+#define MPH_VERSION 1
+/* seeds tried before giving up */
+#define MPH_ATTEMPTS 8
+#define MPH_MAX_PILOT 0xffff
+/* 2^64 divided by the golden ratio */
+#define FIB_FACTOR 0x9e3779b97f4a7c15ULL
+/* 0.6 * 2^32 */
+#define MPH_DENSE_KEYS 0x9999999aULL
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct mph_header {
+	uint64_t magic;
+	uint64_t version;
+	uint64_t data_size;
+	uint64_t key_size;
+	uint64_t value_offset;
+	uint64_t nmembs;
+	uint64_t nslots;
+	uint64_t nbuckets;
+	uint64_t seed;
+};
+
+struct mph {
+	struct mph_header header;
+	hash_func hash;
+	cmp_func compare;
+	const uint16_t *pilots;
+	const uint32_t *remap;
+	const unsigned char *slots;
+	/* everything after the header, allocated or mapped */
+	unsigned char *block;
+	size_t block_size;
+	/* the whole file if mapped, or NULL */
+	void *map;
+	size_t map_length;
+};
+
+enum { BUILD_OK, BUILD_RETRY, BUILD_FAIL };
+
+static size_t align8(size_t n)
+{
+	return (n + 7) & ~(size_t)7;
+}
+
+static uint64_t mph_code(const mph *p, const void *data)
+{
+	uint64_t code = p->hash ? p->hash(data) :
+		hash_bytes(data, p->header.key_size, 0);
+	return hash_mix64(code ^ p->header.seed);
+}
+
+/* the upper half of code sends 60% of the keys to the first 30% */
+/* of the buckets, and the lower half picks one of them */
+static size_t bucket_of(uint64_t nbuckets, uint64_t code)
+{
+	uint64_t dense = nbuckets * 3 / 10;
+	if((code >> 32) < MPH_DENSE_KEYS)
+		return (size_t)(((code & 0xffffffff) * dense) >> 32);
+	return (size_t)(dense +
+			(((code & 0xffffffff) * (nbuckets - dense)) >> 32));
+}
+
+/* mix is hash_mix64 of the pilot; the multiplication lets the */
+/* lower bits of code reach the upper half */
+static size_t slot_of(uint64_t nslots, uint64_t code, uint64_t mix)
+{
+	return (size_t)(((((code ^ mix) * FIB_FACTOR) >> 32) * nslots) >> 32);
+}
+
+/* size the table for n elements and point the parts into block */
+static bool mph_layout(mph *p, size_t n)
+{
+	size_t pilot_bytes, remap_bytes;
+
+	p->header.nmembs = n;
+	p->header.nslots = n + n / 64 + 1;
+	p->header.nbuckets = n / MPH_BUCKET_LOAD + 1;
+	pilot_bytes = align8(p->header.nbuckets * sizeof(uint16_t));
+	remap_bytes = align8((p->header.nslots - n) * sizeof(uint32_t));
+	p->block_size = pilot_bytes + remap_bytes + n * p->header.data_size;
+	p->block = (unsigned char *)calloc(p->block_size, 1);
+	if(!p->block) {
+		hash_error("failed to allocate memory");
+		return false;
+	}
+	p->pilots = (const uint16_t *)p->block;
+	p->remap = (const uint32_t *)(p->block + pilot_bytes);
+	p->slots = p->block + pilot_bytes + remap_bytes;
+	return true;
+}
+
+/* find a pilot for every bucket with the current seed, and set */
+/* pos[i] to the slot of element i */
+static int mph_place(mph *p, const void **elems, size_t *pos)
+{
+	size_t n = p->header.nmembs, nslots = p->header.nslots;
+	size_t nbuckets = p->header.nbuckets;
+	uint64_t *codes = (uint64_t *)malloc(n * sizeof(uint64_t));
+	size_t *order = (size_t *)malloc(n * sizeof(size_t));
+	size_t *start = (size_t *)calloc(nbuckets + 1, sizeof(size_t));
+	size_t *by_size = (size_t *)malloc(nbuckets * sizeof(size_t));
+	size_t *count = NULL;
+	uint64_t *taken = (uint64_t *)calloc(nslots / 64 + 1,
+			sizeof(uint64_t));
+	uint16_t *pilots = (uint16_t *)p->pilots;
+	size_t i, j, k, max = 0;
+	int res = BUILD_FAIL;
+
+	if(!codes || !order || !start || !by_size || !taken) {
+		hash_error("failed to allocate memory");
+		goto OUT;
+	}
+	/* counting sort of the elements by bucket */
+	for(i = 0; i < n; i++) {
+		codes[i] = mph_code(p, elems[i]);
+		start[bucket_of(nbuckets, codes[i]) + 1]++;
+	}
+	for(i = 0; i < nbuckets; i++) {
+		if(start[i + 1] > max)
+			max = start[i + 1];
+		start[i + 1] += start[i];
+	}
+	for(i = 0; i < n; i++)
+		order[start[bucket_of(nbuckets, codes[i])]++] = i;
+	memmove(start + 1, start, nbuckets * sizeof(size_t));
+	start[0] = 0;
+	/* and of the buckets by size, largest first */
+	count = (size_t *)calloc(max + 2, sizeof(size_t));
+	if(!count) {
+		hash_error("failed to allocate memory");
+		goto OUT;
+	}
+	for(i = 0; i < nbuckets; i++)
+		count[max - (start[i + 1] - start[i]) + 1]++;
+	for(i = 0; i <= max; i++)
+		count[i + 1] += count[i];
+	for(i = 0; i < nbuckets; i++)
+		by_size[count[max - (start[i + 1] - start[i])]++] = i;
+
+	for(k = 0; k < nbuckets; k++) {
+		size_t b = by_size[k], s = start[b], e = start[b + 1];
+		uint32_t pilot;
+		if(s == e)
+			break;
+		/* keys of equal codes collide under every pilot */
+		for(i = s; i < e; i++) {
+			for(j = i + 1; j < e; j++) {
+				if(codes[order[i]] == codes[order[j]]) {
+					hash_error("hash codes of two keys collide");
+					goto OUT;
+				}
+			}
+		}
+		for(pilot = 0; pilot <= MPH_MAX_PILOT; pilot++) {
+			uint64_t mix = hash_mix64(pilot);
+			for(i = s; i < e; i++) {
+				size_t q = slot_of(nslots, codes[order[i]], mix);
+				if(taken[q / 64] >> (q % 64) & 1)
+					break;
+				taken[q / 64] |= (uint64_t)1 << (q % 64);
+				pos[order[i]] = q;
+			}
+			if(i == e)
+				break;
+			/* undo the slots taken so far */
+			for(j = s; j < i; j++) {
+				size_t q = pos[order[j]];
+				taken[q / 64] &= ~((uint64_t)1 << (q % 64));
+			}
+		}
+		if(pilot > MPH_MAX_PILOT) {
+			res = BUILD_RETRY;
+			goto OUT;
+		}
+		pilots[b] = (uint16_t)pilot;
+	}
+
+	/* send slots at or past n to the holes below n */
+	for(i = 0, j = n; j < nslots; j++) {
+		if(!(taken[j / 64] >> (j % 64) & 1))
+			continue;
+		while(taken[i / 64] >> (i % 64) & 1)
+			i++;
+		((uint32_t *)p->remap)[j - n] = (uint32_t)i++;
+	}
+	res = BUILD_OK;
+OUT:
+	free(codes);
+	free(order);
+	free(start);
+	free(by_size);
+	free(count);
+	free(taken);
+	return res;
+}
+
+mph *mph_from_hash(hash *h)
+{
+	if(!h) return NULL;
+	/* slots are picked by 32-bit multiplication */
+	if(h->nmembs > UINT32_MAX / 2) {
+		hash_error("too many elements");
+		return NULL;
+	}
+	mph *p = (mph *)calloc(1, sizeof(mph));
+	size_t n = h->nmembs, i;
+	const void **elems = (const void **)malloc((n + 1) * sizeof(void *));
+	size_t *pos = (size_t *)malloc((n + 1) * sizeof(size_t));
+	struct hash_iter it;
+	void *data;
+	int res = BUILD_FAIL, attempt;
+
+	if(!p || !elems || !pos) {
+		hash_error("failed to allocate memory");
+		goto FAILED;
+	}
+	p->header.magic = MPH_MAGIC;
+	p->header.version = MPH_VERSION;
+	p->header.data_size = h->data_size;
+	p->header.key_size = h->key_size;
+	p->header.value_offset = h->value_offset;
+	p->hash = h->hash;
+	p->compare = h->compare;
+	if(!mph_layout(p, n))
+		goto FAILED;
+	memset(&it, 0, sizeof(it));
+	for(i = 0; (data = hash_next(h, &it)) != NULL; i++)
+		elems[i] = data;
+
+	for(attempt = 0; attempt < MPH_ATTEMPTS; attempt++) {
+		p->header.seed = hash_mix64(attempt + 1);
+		memset(p->block, 0, p->block_size);
+		res = mph_place(p, elems, pos);
+		if(res != BUILD_RETRY)
+			break;
+	}
+	if(res != BUILD_OK) {
+		if(res == BUILD_RETRY)
+			hash_error("failed to find pilots");
+		goto FAILED;
+	}
+	for(i = 0; i < n; i++) {
+		size_t q = pos[i] < n ? pos[i] : p->remap[pos[i] - n];
+		memcpy((unsigned char *)p->slots + q * h->data_size,
+				elems[i], h->data_size);
+	}
+	free(elems);
+	free(pos);
+	return p;
+
+FAILED:
+	free(elems);
+	free(pos);
+	mph_free(p);
+	return NULL;
+}
+
+mph *mph_build(struct hash_init *h_init, const void *data, size_t n)
+{
+	if(!h_init) {
+		hash_error("incorrect hash_init structure");
+		return NULL;
+	}
+	struct hash_init init = *h_init;
+	hash *h;
+	mph *p;
+
+	/* a chained table drops the duplicates and lays out maps */
+	init.type = HASH_CHAINED;
+	h = hash_build(&init, data, n);
+	if(!h) return NULL;
+	p = mph_from_hash(h);
+	hash_free(h);
+	return p;
+}
+
+void *mph_search(const mph *p, const void *data)
+{
+	size_t n = p->header.nmembs, q;
+	uint64_t code;
+	const unsigned char *slot;
+
+	if(n == 0) return NULL;
+	code = mph_code(p, data);
+	q = slot_of(p->header.nslots, code,
+			hash_mix64(p->pilots[bucket_of(p->header.nbuckets, code)]));
+	if(q >= n)
+		q = p->remap[q - n];
+	slot = p->slots + q * p->header.data_size;
+	return p->compare(slot, data) == 0 ? (void *)slot : NULL;
+}
+
+void *mph_value(const mph *p, const void *data)
+{
+	return (unsigned char *)data + p->header.value_offset;
+}
+
+size_t mph_nmembs(const mph *p)
+{
+	return p->header.nmembs;
+}
+
+size_t mph_meta_bytes(const mph *p)
+{
+	return sizeof(mph) + p->block_size -
+		p->header.nmembs * p->header.data_size;
+}
+
+bool mph_save(const mph *p, const char *path)
+{
+	if(!p || !path) return false;
+	FILE *fp = fopen(path, "wb");
+	bool res;
+
+	if(!fp) {
+		hash_error("failed to open file");
+		return false;
+	}
+	res = fwrite(&p->header, sizeof(p->header), 1, fp) == 1 &&
+		fwrite(p->block, 1, p->block_size, fp) == p->block_size;
+	if(fclose(fp) != 0)
+		res = false;
+	if(!res)
+		hash_error("failed to write file");
+	return res;
+}
+
+/* check that a file of length bytes holds a well formed table, and */
+/* set the sizes of its parts; sizes are checked one part at a time */
+/* so that no product can overflow, and remap, read without checks */
+/* by mph_search, must send every slot past nmembs to one below it */
+static bool mph_valid(const void *base, size_t length,
+		size_t *pilot_bytes, size_t *remap_bytes)
+{
+	const struct mph_header *hd = (const struct mph_header *)base;
+	size_t avail = length - sizeof(struct mph_header);
+	const uint32_t *remap;
+	uint64_t extra, i;
+
+	if(hd->magic != MPH_MAGIC || hd->version != MPH_VERSION ||
+			hd->nslots <= hd->nmembs || hd->nmembs > UINT32_MAX ||
+			hd->nbuckets == 0 || hd->key_size > hd->data_size ||
+			hd->value_offset > hd->data_size)
+		return false;
+	if(hd->nbuckets > avail / sizeof(uint16_t))
+		return false;
+	*pilot_bytes = align8((size_t)hd->nbuckets * sizeof(uint16_t));
+	if(*pilot_bytes > avail)
+		return false;
+	avail -= *pilot_bytes;
+	extra = hd->nslots - hd->nmembs;
+	if(extra > avail / sizeof(uint32_t))
+		return false;
+	*remap_bytes = align8((size_t)extra * sizeof(uint32_t));
+	if(*remap_bytes > avail)
+		return false;
+	avail -= *remap_bytes;
+	if(hd->data_size ? hd->nmembs > avail / hd->data_size ||
+			hd->nmembs * hd->data_size != avail : avail != 0)
+		return false;
+	remap = (const uint32_t *)((const unsigned char *)(hd + 1) +
+			*pilot_bytes);
+	for(i = 0; i < extra; i++)
+		if(remap[i] >= hd->nmembs && hd->nmembs)
+			return false;
+	return true;
+}
+
+mph *mph_map(const char *path, struct hash_init *h_init)
+{
+	if(!path || !h_init || !h_init->cmp_func) {
+		hash_error("incorrect hash_init structure");
+		return NULL;
+	}
+	mph *p = (mph *)calloc(1, sizeof(mph));
+	const struct mph_header *hd;
+	size_t pilot_bytes, remap_bytes;
+	struct stat st;
+	int fd;
+
+	if(!p) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	fd = open(path, O_RDONLY);
+	if(fd < 0 || fstat(fd, &st) < 0 ||
+			(size_t)st.st_size < sizeof(struct mph_header)) {
+		hash_error("failed to open file");
+		if(fd >= 0)
+			close(fd);
+		free(p);
+		return NULL;
+	}
+	p->map_length = (size_t)st.st_size;
+	p->map = mmap(NULL, p->map_length, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p->map == MAP_FAILED) {
+		hash_error("failed to map file");
+		free(p);
+		return NULL;
+	}
+	hd = (const struct mph_header *)p->map;
+	if(!mph_valid(p->map, p->map_length, &pilot_bytes, &remap_bytes) ||
+			(h_init->key_size ? h_init->key_size != hd->key_size :
+			 h_init->data_size && h_init->data_size != hd->data_size)) {
+		hash_error("incorrect file");
+		munmap(p->map, p->map_length);
+		free(p);
+		return NULL;
+	}
+	p->header = *hd;
+	p->hash = h_init->hash_func;
+	p->compare = h_init->cmp_func;
+	p->block = (unsigned char *)(hd + 1);
+	p->block_size = p->map_length - sizeof(struct mph_header);
+	p->pilots = (const uint16_t *)p->block;
+	p->remap = (const uint32_t *)(p->block + pilot_bytes);
+	p->slots = p->block + pilot_bytes + remap_bytes;
+	return p;
+}
+
+void mph_free(mph *p)
+{
+	if(!p) return;
+	if(p->map)
+		munmap(p->map, p->map_length);
+	else
+		free(p->block);
+	free(p);
+}
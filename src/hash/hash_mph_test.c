@@ -0,0 +1,204 @@
+#include "hash_mph.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define MAXSIZE (1<<20)
+#define PATH "/tmp/hash_mph_test.mph"
+#define BAD_PATH "/tmp/hash_mph_test.bad"
+/* header fields, as 64-bit words */
+#define DATA_SIZE 2
+#define KEY_SIZE 3
+#define NMEMBS 5
+#define NSLOTS 6
+#define NBUCKETS 7
+#define HEADER_BYTES 72
+
+struct pair {
+	int key;
+	long value;
+};
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+/* every key maps to its own element, and no other key is found */
+int check(mph *p, int n)
+{
+	int i;
+	struct pair *x;
+
+	if(mph_nmembs(p) != (size_t)n)
+		return 0;
+	for(i = -n; i < 2 * n; i++) {
+		x = (struct pair *)mph_search(p, &i);
+		if((x != NULL) != (i >= 0 && i < n))
+			return 0;
+		if(x && (x->key != i ||
+					*(long *)mph_value(p, x) != 3L * i))
+			return 0;
+	}
+	return 1;
+}
+
+/* write file with width bytes at offset at set to value, and cut */
+/* bytes cut off the end, to BAD_PATH */
+bool write_bad(unsigned char *file, size_t len, size_t at,
+		uint64_t value, size_t width, size_t cut)
+{
+	unsigned char saved[8];
+	FILE *fp = fopen(BAD_PATH, "wb");
+	bool res;
+
+	memcpy(saved, file + at, width);
+	memcpy(file + at, &value, width);
+	res = fp && fwrite(file, 1, len - cut, fp) == len - cut;
+	if(fp && fclose(fp) != 0)
+		res = false;
+	memcpy(file + at, saved, width);
+	return res;
+}
+
+/* a corrupt copy of the file at PATH is refused by mph_map */
+int check_corrupt(struct hash_init *h_init)
+{
+	FILE *fp = fopen(PATH, "rb");
+	unsigned char *file = NULL;
+	uint64_t hd[HEADER_BYTES / 8];
+	size_t len = 0, i, remap;
+	int res = 0;
+
+	if(!fp || fread(hd, sizeof(hd), 1, fp) != 1)
+		goto OUT;
+	fseek(fp, 0, SEEK_END);
+	len = (size_t)ftell(fp);
+	rewind(fp);
+	file = malloc(len);
+	if(!file || fread(file, 1, len, fp) != len)
+		goto OUT;
+	remap = HEADER_BYTES + ((hd[NBUCKETS] * 2 + 7) & ~(size_t)7);
+	struct {
+		size_t at;
+		uint64_t value;
+		size_t width;
+		size_t cut;
+	} bad[] = {
+		{ 0, hd[0], 8, 8 },
+		{ NBUCKETS * 8, (uint64_t)1 << 62, 8, 0 },
+		{ NBUCKETS * 8, hd[NBUCKETS] + 4, 8, 0 },
+		{ NSLOTS * 8, hd[NMEMBS], 8, 0 },
+		{ NSLOTS * 8, (uint64_t)1 << 62, 8, 0 },
+		{ NMEMBS * 8, (uint64_t)1 << 61, 8, 0 },
+		{ NMEMBS * 8, hd[NMEMBS] + 1, 8, 0 },
+		{ DATA_SIZE * 8, 1, 8, 0 },
+		{ KEY_SIZE * 8, hd[DATA_SIZE] + 1, 8, 0 },
+		{ remap, (uint32_t)hd[NMEMBS], 4, 0 },
+	};
+	for(i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+		mph *p;
+		if(!write_bad(file, len, bad[i].at, bad[i].value,
+					bad[i].width, bad[i].cut))
+			goto OUT;
+		p = mph_map(BAD_PATH, h_init);
+		if(p) {
+			fprintf(stderr, "corrupt file %zu mapped\n", i);
+			mph_free(p);
+			goto OUT;
+		}
+	}
+	res = 1;
+OUT:
+	if(fp)
+		fclose(fp);
+	free(file);
+	remove(BAD_PATH);
+	return res;
+}
+
+int main(void)
+{
+	struct pair *pairs = malloc(2 * MAXSIZE * sizeof(struct pair));
+	struct hash_init h_init;
+	hash *h = NULL;
+	mph *p;
+	int i;
+
+	if(!pairs) {
+		fprintf(stderr, "failed to allocate memory\n");
+		goto FAILED;
+	}
+	/* every key twice, the second one with the right value */
+	for(i = 0; i < 2 * MAXSIZE; i++) {
+		pairs[i].key = i % MAXSIZE;
+		pairs[i].value = i < MAXSIZE ? -1 : 3L * (i % MAXSIZE);
+	}
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.key_size = sizeof(int);
+	h_init.value_size = sizeof(long);
+	h_init.cmp_func = compare;
+	h_init.hash_func = hash_int;
+	p = mph_build(&h_init, pairs, 2 * MAXSIZE);
+	if(!p || !check(p, MAXSIZE)) {
+		fprintf(stderr, "build error\n");
+		goto FAILED;
+	}
+	if(mph_meta_bytes(p) * 8.0 / MAXSIZE > 4) {
+		fprintf(stderr, "metadata takes %.2f bits per key\n",
+				mph_meta_bytes(p) * 8.0 / MAXSIZE);
+		goto FAILED;
+	}
+
+	/* round trip through a file */
+	if(!mph_save(p, PATH)) {
+		fprintf(stderr, "save error\n");
+		goto FAILED;
+	}
+	mph_free(p);
+	p = mph_map(PATH, &h_init);
+	if(!p || !check(p, MAXSIZE) || !check_corrupt(&h_init)) {
+		remove(PATH);
+		fprintf(stderr, "map error\n");
+		goto FAILED;
+	}
+	remove(PATH);
+	mph_free(p);
+
+	/* from the table of another engine, and from an empty one */
+	h_init.type = HASH_SWISS;
+	h = hash_init(&h_init);
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	p = mph_from_hash(h);
+	if(!p || !check(p, 0)) {
+		fprintf(stderr, "build error\n");
+		goto FAILED;
+	}
+	mph_free(p);
+	for(i = 0; i < 1000; i++)
+		hash_insert(h, &pairs[MAXSIZE + i]);
+	p = mph_from_hash(h);
+	if(!p || !check(p, 1000)) {
+		fprintf(stderr, "build error\n");
+		goto FAILED;
+	}
+	mph_free(p);
+	hash_free(h);
+	free(pairs);
+	printf("----------passed----------\n");
+	return 0;
+
+FAILED:
+	hash_free(h);
+	free(pairs);
+	printf("----------failed----------\n");
+	return 1;
+}
@@ -0,0 +1,153 @@
+#include "hash_multi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ *    map:   | key | run | --> | value 0 | value 1 | ... |   (cap)  |
+ *
+ * The value of each key in the map is a run: a pointer to an array
+ * of cap values, n of which are in use. A key is in the map only
+ * while it has values.
+ */
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct run {
+	unsigned char *values;
+	size_t n;
+	size_t cap;
+};
+
+struct hash_multi {
+	hash *h;
+	size_t value_size;
+	size_t nvalues;
+	/* element-sized buffer for hash_delete */
+	unsigned char *scratch;
+};
+
+static struct run *run_of(hash_multi *m, const void *key)
+{
+	void *data = hash_find(m->h, key);
+	return data ? (struct run *)hash_value(m->h, data) : NULL;
+}
+
+hash_multi *hash_multi_init(struct hash_init *h_init)
+{
+	if(!h_init || !h_init->key_size || !h_init->value_size) {
+		hash_error("incorrect hash_init structure");
+		return NULL;
+	}
+	hash_multi *m = (hash_multi *)malloc(sizeof(hash_multi));
+	struct hash_init init = *h_init;
+
+	if(!m) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	init.value_size = sizeof(struct run);
+	m->h = hash_init(&init);
+	m->scratch = m->h ? (unsigned char *)malloc(m->h->data_size) : NULL;
+	if(!m->scratch) {
+		hash_error("failed to allocate memory");
+		hash_free(m->h);
+		free(m);
+		return NULL;
+	}
+	m->value_size = h_init->value_size;
+	m->nvalues = 0;
+	return m;
+}
+
+bool hash_multi_insert(hash_multi *m, const void *key, const void *value)
+{
+	bool inserted;
+	struct run *r = (struct run *)hash_get_or_insert(m->h, key, &inserted);
+
+	if(!r) return false;
+	if(r->n == r->cap) {
+		size_t cap = r->cap ? r->cap * 2 : 1;
+		unsigned char *values = (unsigned char *)
+			realloc(r->values, cap * m->value_size);
+		if(!values) {
+			hash_error("failed to allocate memory");
+			/* do not leave a key without values */
+			if(inserted)
+				hash_multi_delete(m, key);
+			return false;
+		}
+		r->values = values;
+		r->cap = cap;
+	}
+	memcpy(r->values + r->n++ * m->value_size, value, m->value_size);
+	m->nvalues++;
+	return true;
+}
+
+void *hash_equal_range(hash_multi *m, const void *key, size_t *count)
+{
+	struct run *r = run_of(m, key);
+
+	if(!r) {
+		if(count)
+			*count = 0;
+		return NULL;
+	}
+	if(count)
+		*count = r->n;
+	return r->values;
+}
+
+bool hash_multi_erase(hash_multi *m, const void *key, size_t i)
+{
+	struct run *r = run_of(m, key);
+
+	if(!r || i >= r->n) return false;
+	if(r->n == 1)
+		return hash_multi_delete(m, key);
+	r->n--;
+	if(i != r->n)
+		memcpy(r->values + i * m->value_size,
+				r->values + r->n * m->value_size, m->value_size);
+	m->nvalues--;
+	return true;
+}
+
+bool hash_multi_delete(hash_multi *m, const void *key)
+{
+	struct run *r = run_of(m, key);
+
+	if(!r) return false;
+	free(r->values);
+	m->nvalues -= r->n;
+	memcpy(m->scratch, key, m->h->key_size);
+	return hash_delete(m->h, m->scratch);
+}
+
+size_t hash_multi_nkeys(const hash_multi *m)
+{
+	return m->h->nmembs;
+}
+
+size_t hash_multi_nvalues(const hash_multi *m)
+{
+	return m->nvalues;
+}
+
+static void free_run(void *data, void *arg)
+{
+	hash_multi *m = (hash_multi *)arg;
+	free(((struct run *)hash_value(m->h, data))->values);
+}
+
+void hash_multi_free(hash_multi *m)
+{
+	if(!m) return;
+	hash_foreach(m->h, free_run, m);
+	hash_free(m->h);
+	free(m->scratch);
+	free(m);
+}
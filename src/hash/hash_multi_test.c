@@ -0,0 +1,120 @@
+#include "hash_multi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define MAXSIZE (1<<18)
+#define NKEYS 1000
+
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+int main(void)
+{
+	hash_multi *m = NULL;
+	struct hash_init h_init;
+	size_t count, j;
+	long *v;
+	int i, type;
+
+	for(type = HASH_CHAINED; type <= HASH_CUCKOO; type++) {
+		memset(&h_init, 0, sizeof(h_init));
+		h_init.type = type;
+		h_init.size = 16;
+		h_init.key_size = sizeof(int);
+		h_init.value_size = sizeof(long);
+		h_init.cmp_func = compare;
+		m = hash_multi_init(&h_init);
+		if(!m) {
+			fprintf(stderr, "failed to initialize hash\n");
+			goto FAILED;
+		}
+
+		/* key i % NKEYS gets the values i, in order */
+		for(i = 0; i < MAXSIZE; i++) {
+			int key = i % NKEYS;
+			long value = i;
+			if(!hash_multi_insert(m, &key, &value)) {
+				fprintf(stderr, "insert error\n");
+				goto FAILED;
+			}
+		}
+		if(hash_multi_nkeys(m) != NKEYS ||
+				hash_multi_nvalues(m) != MAXSIZE) {
+			fprintf(stderr, "insert error\n");
+			goto FAILED;
+		}
+		for(i = 0; i < 2 * NKEYS; i++) {
+			v = (long *)hash_equal_range(m, &i, &count);
+			if((v == NULL) != (i >= NKEYS) || (v && count !=
+						(size_t)(MAXSIZE / NKEYS +
+							(i < MAXSIZE % NKEYS)))) {
+				fprintf(stderr, "equal_range error\n");
+				goto FAILED;
+			}
+			for(j = 0; v && j < count; j++) {
+				if(v[j] != i + (long)j * NKEYS) {
+					fprintf(stderr, "equal_range error\n");
+					goto FAILED;
+				}
+			}
+		}
+
+		/* erase the first value of even keys, delete odd keys */
+		for(i = 0; i < NKEYS; i++) {
+			if(!(i % 2 ? hash_multi_delete(m, &i) :
+						hash_multi_erase(m, &i, 0))) {
+				fprintf(stderr, "erase error\n");
+				goto FAILED;
+			}
+		}
+		if(hash_multi_erase(m, &i, 0) || hash_multi_delete(m, &i) ||
+				hash_multi_nkeys(m) != NKEYS / 2) {
+			fprintf(stderr, "erase error\n");
+			goto FAILED;
+		}
+		for(i = 0, count = 0; i < NKEYS; i++) {
+			size_t n;
+			v = (long *)hash_equal_range(m, &i, &n);
+			if((v == NULL) != (i % 2 == 1)) {
+				fprintf(stderr, "erase error\n");
+				goto FAILED;
+			}
+			/* the last value took the place of the first */
+			for(j = 0; j < n; j++) {
+				if(v[j] == i) {
+					fprintf(stderr, "erase error\n");
+					goto FAILED;
+				}
+			}
+			count += n;
+		}
+		if(count != hash_multi_nvalues(m)) {
+			fprintf(stderr, "erase error\n");
+			goto FAILED;
+		}
+		/* a key erased down to no values is gone */
+		i = 0;
+		while(hash_equal_range(m, &i, &count))
+			hash_multi_erase(m, &i, count - 1);
+		if(hash_multi_nkeys(m) != NKEYS / 2 - 1) {
+			fprintf(stderr, "erase error\n");
+			goto FAILED;
+		}
+		hash_multi_free(m);
+	}
+	printf("----------passed----------\n");
+	return 0;
+
+FAILED:
+	hash_multi_free(m);
+	printf("----------failed----------\n");
+	return 1;
+}
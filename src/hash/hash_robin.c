@@ -0,0 +1,351 @@
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ *    meta:  |h,1|h,2|h,2| 0 |h,1|h,1|h,2| 0 |   (hash bits, distance + 1)
+ *    slots: | d | d | d |   | d | d | d |   |
+ *
+ * Linear probing where an element being inserted takes the slot of
+ * any element that is closer to its home slot ("rich"), which then
+ * continues probing in its place. Probe distances stay close to the
+ * mean, and a lookup can stop as soon as it meets an element closer
+ * to home than itself. Deletion shifts the following elements back
+ * by one slot, so there are no tombstones.
+ */
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct robin_meta {
+	uint32_t code;
+	/* probe distance + 1, 0 for an empty slot */
+	uint32_t dist;
+};
+
+struct robin {
+	struct robin_meta *meta;
+	unsigned char *slots;
+	size_t data_size;
+	size_t capacity;
+	size_t max_nmembs;
+	double max_load;
+	/* buffers of data_size bytes used while swapping elements, */
+	/* and to make an element from a key */
+	unsigned char *tmp;
+	unsigned char *rec;
+};
+
+static bool robin_init(hash *h, struct hash_init *h_init);
+static bool robin_insert(hash *h, const void *data);
+static bool robin_delete(hash *h, void *data);
+static void *robin_search(hash *h, const void *data);
+static void robin_free(hash *h);
+static void robin_stats(hash *h, struct hash_stats *st);
+static void *robin_next(hash *h, struct hash_iter *it);
+static void *robin_get_or_insert(hash *h, const void *key, bool *inserted);
+
+const struct hash_ops hash_robin_ops = {
+	robin_init,
+	robin_insert,
+	robin_delete,
+	robin_search,
+	robin_free,
+	robin_stats,
+	robin_next,
+	robin_get_or_insert,
+};
+
+static void *slot_at(const struct robin *r, size_t i)
+{
+	return r->slots + i * r->data_size;
+}
+
+/* allocate empty arrays of given capacity, a power of two */
+static bool robin_alloc(struct robin *r, size_t capacity)
+{
+	struct robin_meta *meta = (struct robin_meta *)
+		calloc(capacity, sizeof(struct robin_meta));
+	unsigned char *slots = (unsigned char *)
+		malloc(capacity * r->data_size);
+	if(!meta || !slots) {
+		free(meta);
+		free(slots);
+		return false;
+	}
+	r->meta = meta;
+	r->slots = slots;
+	r->capacity = capacity;
+	r->max_nmembs = (size_t)(r->max_load * capacity);
+	if(r->max_nmembs >= capacity)
+		r->max_nmembs = capacity - 1;
+	return true;
+}
+
+/* find the index of the slot holding data, or return -1 */
+static long robin_find(hash *h, const void *data, uint64_t code)
+{
+	struct robin *r = (struct robin *)h->engine;
+	size_t mask = r->capacity - 1;
+	size_t i = (size_t)code & mask;
+	uint32_t dist = 1;
+
+	for(;;) {
+		struct robin_meta *m = &r->meta[i];
+		/* an empty slot, or an element closer to its home than
+		 * we are, means data would have been placed before it */
+		if(m->dist < dist) {
+			HASH_STAT(hash_count_lookup(h, false, dist));
+			return -1;
+		}
+		if(m->code == (uint32_t)(code >> 32) &&
+				hash_cmp(h, slot_at(r, i), data) == 0) {
+			HASH_STAT(hash_count_lookup(h, true, dist));
+			return (long)i;
+		}
+		i = (i + 1) & mask;
+		dist++;
+	}
+}
+
+/* place data known to be absent, displacing richer elements */
+/* return the index of the slot data went to */
+static size_t robin_place(struct robin *r, const void *data, uint64_t code)
+{
+	size_t mask = r->capacity - 1;
+	size_t i = (size_t)code & mask;
+	size_t placed = 0;
+	struct robin_meta cur = { (uint32_t)(code >> 32), 1 };
+	bool carrying = false;
+
+	for(;;) {
+		struct robin_meta *m = &r->meta[i];
+		if(m->dist == 0) {
+			*m = cur;
+			memcpy(slot_at(r, i), carrying ? r->tmp : data,
+					r->data_size);
+			return carrying ? placed : i;
+		}
+		if(m->dist < cur.dist) {
+			/* swap the element we carry with the richer one */
+			struct robin_meta t = *m;
+			*m = cur;
+			cur = t;
+			if(!carrying) {
+				memcpy(r->tmp, slot_at(r, i), r->data_size);
+				memcpy(slot_at(r, i), data, r->data_size);
+				placed = i;
+				carrying = true;
+			} else {
+				unsigned char *s = (unsigned char *)slot_at(r, i);
+				size_t k;
+				for(k = 0; k < r->data_size; k++) {
+					unsigned char c = s[k];
+					s[k] = r->tmp[k];
+					r->tmp[k] = c;
+				}
+			}
+		}
+		i = (i + 1) & mask;
+		cur.dist++;
+	}
+}
+
+/* move all elements into arrays of given capacity */
+static bool robin_rehash(hash *h, size_t capacity)
+{
+	struct robin *r = (struct robin *)h->engine;
+	struct robin old = *r;
+	size_t i;
+
+	if(!robin_alloc(r, capacity)) {
+		*r = old;
+		return false;
+	}
+	for(i = 0; i < old.capacity; i++) {
+		if(old.meta[i].dist == 0)
+			continue;
+		void *data = slot_at(&old, i);
+		robin_place(r, data, hash_mix64(hash_code(h, data)));
+	}
+	free(old.meta);
+	free(old.slots);
+	return true;
+}
+
+bool robin_init(hash *h, struct hash_init *h_init)
+{
+	struct robin *r = (struct robin *)malloc(sizeof(struct robin));
+	size_t size = h_init->size ? h_init->size : HASH_INIT_SIZE;
+	size_t capacity = 2;
+
+	if(!r) return false;
+	r->tmp = (unsigned char *)malloc(h->data_size ? h->data_size : 1);
+	r->rec = (unsigned char *)malloc(h->data_size ? h->data_size : 1);
+	if(!r->tmp || !r->rec) {
+		free(r->tmp);
+		free(r->rec);
+		free(r);
+		return false;
+	}
+	while(capacity < size)
+		capacity *= 2;
+	r->data_size = h->data_size;
+	r->max_load = h_init->max_load > 0 && h_init->max_load < 1 ?
+		h_init->max_load : HASH_ROBIN_MAX_LOAD;
+	if(!robin_alloc(r, capacity)) {
+		free(r->tmp);
+		free(r->rec);
+		free(r);
+		return false;
+	}
+	h->engine = r;
+	h->size = r->capacity;
+	return true;
+}
+
+/* make room for one more element */
+static bool robin_reserve(hash *h)
+{
+	struct robin *r = (struct robin *)h->engine;
+	if(h->nmembs + 1 > r->max_nmembs) {
+		if(!robin_rehash(h, r->capacity * 2)) {
+			hash_error("failed to allocate memory");
+			return false;
+		}
+		h->size = r->capacity;
+	}
+	return true;
+}
+
+bool robin_insert(hash *h, const void *data)
+{
+	struct robin *r = (struct robin *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, data));
+	long found = robin_find(h, data, code);
+	if(found >= 0) {
+		memcpy(slot_at(r, found), data, r->data_size);
+		return true;
+	}
+	if(!robin_reserve(h))
+		return false;
+	robin_place(r, data, code);
+	h->nmembs++;
+	return true;
+}
+
+void *robin_get_or_insert(hash *h, const void *key, bool *inserted)
+{
+	struct robin *r = (struct robin *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, key));
+	long found = robin_find(h, key, code);
+	*inserted = found < 0;
+	if(found >= 0)
+		return slot_at(r, found);
+	if(!robin_reserve(h))
+		return NULL;
+	memcpy(r->rec, key, h->key_size);
+	memset(r->rec + h->key_size, 0, r->data_size - h->key_size);
+	found = (long)robin_place(r, r->rec, code);
+	h->nmembs++;
+	return slot_at(r, found);
+}
+
+bool robin_delete(hash *h, void *data)
+{
+	struct robin *r = (struct robin *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, data));
+	long found = robin_find(h, data, code);
+	if(found < 0)
+		return false;
+	memcpy(data, slot_at(r, found), r->data_size);
+
+	/* shift following elements back until one is in its home
+	 * slot or the run ends */
+	size_t mask = r->capacity - 1;
+	size_t i = (size_t)found;
+	size_t j = (i + 1) & mask;
+	while(r->meta[j].dist > 1) {
+		r->meta[i].code = r->meta[j].code;
+		r->meta[i].dist = r->meta[j].dist - 1;
+		memcpy(slot_at(r, i), slot_at(r, j), r->data_size);
+		i = j;
+		j = (j + 1) & mask;
+	}
+	r->meta[i].dist = 0;
+	h->nmembs--;
+	return true;
+}
+
+void *robin_search(hash *h, const void *data)
+{
+	struct robin *r = (struct robin *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, data));
+	long found = robin_find(h, data, code);
+	return found < 0 ? NULL : slot_at(r, found);
+}
+
+void robin_free(hash *h)
+{
+	struct robin *r = (struct robin *)h->engine;
+	free(r->meta);
+	free(r->slots);
+	free(r->tmp);
+	free(r->rec);
+	free(r);
+}
+
+void robin_stats(hash *h, struct hash_stats *st)
+{
+	struct robin *r = (struct robin *)h->engine;
+	size_t i;
+
+	st->bytes += sizeof(struct robin) + 2 * r->data_size +
+		r->capacity * (sizeof(struct robin_meta) + r->data_size);
+	for(i = 0; i < r->capacity; i++) {
+		size_t d;
+		if(r->meta[i].dist == 0)
+			continue;
+		d = r->meta[i].dist - 1;
+		if(d > st->max_chain)
+			st->max_chain = d;
+		st->hist[d < HASH_HIST_SIZE ? d : HASH_HIST_SIZE - 1]++;
+	}
+}
+
+/* report the longest and the mean probe distance of a HASH_ROBIN */
+/* table, where an element in its home slot has distance 0 */
+/* return false if h is not a HASH_ROBIN table */
+bool hash_robin_probes(hash *h, size_t *max, double *mean)
+{
+	if(!h || h->ops != &hash_robin_ops) return false;
+	struct robin *r = (struct robin *)h->engine;
+	size_t i, longest = 0;
+	double total = 0;
+
+	for(i = 0; i < r->capacity; i++) {
+		if(r->meta[i].dist == 0)
+			continue;
+		if(r->meta[i].dist - 1 > longest)
+			longest = r->meta[i].dist - 1;
+		total += r->meta[i].dist - 1;
+	}
+	if(max)
+		*max = longest;
+	if(mean)
+		*mean = h->nmembs ? total / h->nmembs : 0;
+	return true;
+}
+
+void *robin_next(hash *h, struct hash_iter *it)
+{
+	struct robin *r = (struct robin *)h->engine;
+	while(it->pos < r->capacity) {
+		size_t i = it->pos++;
+		if(r->meta[i].dist != 0)
+			return slot_at(r, i);
+	}
+	return NULL;
+}
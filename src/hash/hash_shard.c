@@ -0,0 +1,143 @@
+#define _POSIX_C_SOURCE 200809L
+#include "hash_shard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#define CACHE_LINE 64
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+/* each shard takes whole cache lines, so that taking the lock of
+ * one shard never invalidates the line of another */
+struct shard {
+	pthread_rwlock_t lock;
+	hash *h;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct shard_hash {
+	struct shard *shards;
+	size_t nshards;
+	/* 64 - log2(nshards), 64 meaning a single shard */
+	int shift;
+};
+
+/* hash as the shard tables do, which for a map hashes the key only */
+static struct shard *shard_of(shard_hash *s, const void *data)
+{
+	return &s->shards[shard_pick(hash_code(s->shards[0].h, data),
+			s->shift)];
+}
+
+shard_hash *shard_init(struct hash_init *h_init, size_t nshards)
+{
+	if(!h_init) {
+		hash_error("incorrect hash_init structure");
+		return NULL;
+	}
+	shard_hash *s = (shard_hash *)malloc(sizeof(shard_hash));
+	struct hash_init init = *h_init;
+	size_t n, i;
+	int shift;
+
+	if(!s) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	n = shard_round(nshards ? nshards : SHARD_DEFAULT_COUNT, &shift);
+	if(posix_memalign((void **)&s->shards, CACHE_LINE,
+				n * sizeof(struct shard))) {
+		hash_error("failed to allocate memory");
+		free(s);
+		return NULL;
+	}
+	init.size = (h_init->size ? h_init->size : HASH_INIT_SIZE) / n;
+	if(init.size == 0)
+		init.size = 1;
+	for(i = 0; i < n; i++) {
+		s->shards[i].h = hash_init(&init);
+		if(!s->shards[i].h ||
+				pthread_rwlock_init(&s->shards[i].lock, NULL)) {
+			hash_error("failed to initialize shard");
+			hash_free(s->shards[i].h);
+			while(i-- > 0) {
+				pthread_rwlock_destroy(&s->shards[i].lock);
+				hash_free(s->shards[i].h);
+			}
+			free(s->shards);
+			free(s);
+			return NULL;
+		}
+	}
+	s->nshards = n;
+	s->shift = shift;
+	return s;
+}
+
+bool shard_insert(shard_hash *s, const void *data)
+{
+	if(!s) return false;
+	struct shard *x = shard_of(s, data);
+	bool res;
+
+	pthread_rwlock_wrlock(&x->lock);
+	res = hash_insert(x->h, data);
+	pthread_rwlock_unlock(&x->lock);
+	return res;
+}
+
+bool shard_delete(shard_hash *s, void *data)
+{
+	if(!s) return false;
+	struct shard *x = shard_of(s, data);
+	bool res;
+
+	pthread_rwlock_wrlock(&x->lock);
+	res = hash_delete(x->h, data);
+	pthread_rwlock_unlock(&x->lock);
+	return res;
+}
+
+bool shard_search(shard_hash *s, const void *data, void *out)
+{
+	if(!s) return false;
+	struct shard *x = shard_of(s, data);
+	void *found;
+
+	/* hash_find leaves the table untouched, so a read lock will do */
+	pthread_rwlock_rdlock(&x->lock);
+	found = hash_find(x->h, data);
+	if(found && out)
+		memcpy(out, found, x->h->data_size);
+	pthread_rwlock_unlock(&x->lock);
+	return found != NULL;
+}
+
+size_t shard_nmembs(shard_hash *s)
+{
+	if(!s) return 0;
+	size_t i, n = 0;
+
+	for(i = 0; i < s->nshards; i++) {
+		pthread_rwlock_rdlock(&s->shards[i].lock);
+		n += s->shards[i].h->nmembs;
+		pthread_rwlock_unlock(&s->shards[i].lock);
+	}
+	return n;
+}
+
+void shard_free(shard_hash *s)
+{
+	if(!s) return;
+	size_t i;
+
+	for(i = 0; i < s->nshards; i++) {
+		pthread_rwlock_destroy(&s->shards[i].lock);
+		hash_free(s->shards[i].h);
+	}
+	free(s->shards);
+	free(s);
+}
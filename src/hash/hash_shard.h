@@ -0,0 +1,62 @@
+/* hash_shard.h defines a thread-safe hash table.
+ *
+ * The key space is split into a power-of-two number of shards by
+ * the high bits of the mixed hash code. Each shard is a hash with
+ * its own reader-writer lock, so writers only block operations on
+ * the same shard and readers of a shard run in parallel.
+ */
+
+#ifndef _HASH_SHARD_H
+#define _HASH_SHARD_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "hash.h"
+
+#define SHARD_DEFAULT_COUNT (64)
+
+/* routing, shared with shard_cache (see cache.h): the high bits of */
+/* the mixed hash code pick one of a power-of-two number of shards, */
+/* as the shard tables pick buckets by their own bits of the code */
+/* round nshards up to a power of two, and set *shift to 64 minus */
+/* its log2, 64 meaning a single shard */
+static inline size_t shard_round(size_t nshards, int *shift)
+{
+	size_t n = 1;
+
+	*shift = 64;
+	while(n < nshards) {
+		n *= 2;
+		(*shift)--;
+	}
+	return n;
+}
+/* index of the shard of hash code code */
+static inline size_t shard_pick(uint64_t code, int shift)
+{
+	return shift == 64 ? 0 : (size_t)(hash_mix64(code) >> shift);
+}
+
+typedef struct shard_hash shard_hash;
+
+/* allocate a table of nshards shards (0 for SHARD_DEFAULT_COUNT), */
+/* each one a hash configured by h_init with size h_init->size / nshards */
+/* return NULL if failed */
+shard_hash *shard_init(struct hash_init *h_init, size_t nshards);
+/* insert data, replacing an equal element */
+/* return true if insert successfully */
+bool shard_insert(shard_hash *s, const void *data);
+/* delete data, copying the deleted element back to data */
+/* return true if found and deleted */
+bool shard_delete(shard_hash *s, void *data);
+/* search data and copy the element found to out, since a pointer */
+/* into the table may be invalidated by another thread */
+/* return true if found */
+bool shard_search(shard_hash *s, const void *data, void *out);
+/* number of elements in all shards */
+size_t shard_nmembs(shard_hash *s);
+/* free all space used by s */
+void shard_free(shard_hash *s);
+
+#endif
@@ -0,0 +1,128 @@
+#include "hash_shard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#define NTHREADS 8
+#define PER_THREAD (1<<16)
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+shard_hash *s;
+
+/* each thread owns keys id, id + NTHREADS, ... and reads all keys */
+void *worker(void *arg)
+{
+	int id = (int)(long)arg;
+	int i, key, out;
+
+	for(i = 0; i < PER_THREAD; i++) {
+		key = i * NTHREADS + id;
+		if(!shard_insert(s, &key))
+			return (void *)1;
+	}
+	for(i = 0; i < PER_THREAD; i++) {
+		key = i * NTHREADS + id;
+		if(!shard_search(s, &key, &out) || out != key)
+			return (void *)1;
+		/* keys of other threads may or may not be there */
+		key = i * NTHREADS + (id + 1) % NTHREADS;
+		if(shard_search(s, &key, &out) && out != key)
+			return (void *)1;
+	}
+	for(i = 0; i < PER_THREAD; i += 2) {
+		key = i * NTHREADS + id;
+		if(!shard_delete(s, &key) || key != i * NTHREADS + id)
+			return (void *)1;
+	}
+	for(i = 0; i < PER_THREAD; i++) {
+		key = i * NTHREADS + id;
+		if(shard_search(s, &key, NULL) != (i % 2 == 1))
+			return (void *)1;
+	}
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t threads[NTHREADS];
+	struct hash_init h_init;
+	long i;
+	void *res;
+
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.size = 1024;
+	h_init.data_size = sizeof(int);
+	h_init.cmp_func = compare;
+	h_init.hash_func = hash_int;
+	s = shard_init(&h_init, 16);
+	if(!s) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	for(i = 0; i < NTHREADS; i++)
+		pthread_create(&threads[i], NULL, worker, (void *)i);
+	for(i = 0; i < NTHREADS; i++) {
+		pthread_join(threads[i], &res);
+		if(res) {
+			fprintf(stderr, "thread %ld error\n", i);
+			goto FAILED;
+		}
+	}
+	if(shard_nmembs(s) != NTHREADS * PER_THREAD / 2) {
+		fprintf(stderr, "nmembs error\n");
+		goto FAILED;
+	}
+	shard_free(s);
+
+	/* a map routes and copies by its own element layout */
+	struct {
+		int key;
+		long value;
+	} kv;
+	h_init.data_size = 0;
+	h_init.key_size = sizeof(int);
+	h_init.value_size = sizeof(long);
+	h_init.hash_func = NULL;
+	s = shard_init(&h_init, 16);
+	if(!s) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	for(i = 0; i < PER_THREAD; i++) {
+		kv.key = (int)i;
+		kv.value = -i;
+		if(!shard_insert(s, &kv)) {
+			fprintf(stderr, "insert error\n");
+			goto FAILED;
+		}
+	}
+	for(i = 0; i < PER_THREAD; i++) {
+		int key = (int)i;
+		kv.value = 0;
+		/* a search by the key alone finds the element */
+		if(!shard_search(s, &key, &kv) || kv.key != i ||
+				kv.value != -i) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+	if(shard_nmembs(s) != PER_THREAD) {
+		fprintf(stderr, "nmembs error\n");
+		goto FAILED;
+	}
+	shard_free(s);
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
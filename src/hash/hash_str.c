@@ -0,0 +1,399 @@
+#include "hash_str.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ *    slots:   |code,len,off| empty |code,len,off| ...
+ *                    |                   |
+ *                    v                   v
+ *    arena:   |id,len|b y t e s\0|  |id,len|b y t e s\0| ...
+ *
+ * Open addressing with linear probing over 16-byte records. Each
+ * record keeps the whole 64-bit hash code: its upper bits pick the
+ * home slot, and comparing all 64 bits still rejects almost every
+ * other string in the probe sequence before the arena is read. Growing
+ * the table never reads the arena either. Each arena entry starts
+ * with its id and length, and is padded to 4 bytes; records give its
+ * offset in 4-byte units.
+ * offsets[id] is the arena offset of the string with that id, and
+ * values[id] its value. Deleting a string empties its record by
+ * shifting the rest of the probe sequence back, marks its arena entry
+ * dead and puts its id on a free list; the arena is compacted when
+ * dead entries take more than half of it.
+ */
+
+#define STR_EMPTY UINT32_MAX
+#define STR_MAX_LOAD 0.75
+/* offsets[id] of a free id: the next free id, with this bit set */
+#define STR_FREE ((uint64_t)1 << 63)
+#define STR_NO_ID (STR_FREE - 1)
+#define STR_UNIT 4
+#define STR_MAX_ARENA ((size_t)UINT32_MAX * STR_UNIT)
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct str_slot {
+	uint64_t code;
+	uint32_t len;
+	uint32_t offset;
+};
+
+struct str_entry {
+	uint32_t id;
+	uint32_t len;
+	char bytes[];
+};
+
+struct str_hash {
+	struct str_slot *slots;
+	size_t capacity;
+	/* 64 - log2(capacity) */
+	int shift;
+	size_t nmembs;
+	unsigned char *arena;
+	size_t arena_used;
+	size_t arena_size;
+	/* bytes of the arena held by deleted strings */
+	size_t arena_dead;
+	/* ids given out so far, and the first free one or STR_NO_ID */
+	uint64_t *offsets;
+	size_t nids;
+	size_t ids_size;
+	uint64_t free_id;
+	unsigned char *values;
+	size_t value_size;
+};
+
+static uint64_t str_code(const char *s, size_t len)
+{
+	return hash_bytes(s, len, 0);
+}
+
+static size_t entry_size(size_t len)
+{
+	return (sizeof(struct str_entry) + len + 1 + STR_UNIT - 1) &
+		~(size_t)(STR_UNIT - 1);
+}
+
+static struct str_entry *entry_at(const str_hash *h, uint64_t offset)
+{
+	return (struct str_entry *)(h->arena + offset);
+}
+
+static struct str_entry *entry_of(const str_hash *h,
+		const struct str_slot *slot)
+{
+	return entry_at(h, (uint64_t)slot->offset * STR_UNIT);
+}
+
+static size_t home_of(const str_hash *h, uint64_t code)
+{
+	return (size_t)(code >> h->shift);
+}
+
+/* return the slot holding the string, or the empty slot ending */
+/* its probe sequence */
+static struct str_slot *str_find(const str_hash *h, const char *s,
+		uint32_t len, uint64_t code)
+{
+	size_t mask = h->capacity - 1;
+	size_t i = home_of(h, code);
+
+	for(;;) {
+		struct str_slot *slot = &h->slots[i];
+		if(slot->len == STR_EMPTY)
+			return slot;
+		if(slot->code == code && slot->len == len && (len == 0 ||
+				memcmp(entry_of(h, slot)->bytes, s, len) == 0))
+			return slot;
+		i = (i + 1) & mask;
+	}
+}
+
+static struct str_slot *slots_alloc(size_t capacity)
+{
+	struct str_slot *slots = (struct str_slot *)
+		malloc(capacity * sizeof(struct str_slot));
+	size_t i;
+
+	if(!slots) return NULL;
+	for(i = 0; i < capacity; i++)
+		slots[i].len = STR_EMPTY;
+	return slots;
+}
+
+/* move all records into twice as many slots */
+static bool str_grow(str_hash *h)
+{
+	size_t capacity = h->capacity * 2, mask = capacity - 1, i;
+	struct str_slot *slots = slots_alloc(capacity);
+	int shift = h->shift - 1;
+
+	if(!slots) return false;
+	for(i = 0; i < h->capacity; i++) {
+		size_t j;
+		if(h->slots[i].len == STR_EMPTY)
+			continue;
+		for(j = (size_t)(h->slots[i].code >> shift);
+				slots[j].len != STR_EMPTY; j = (j + 1) & mask)
+			;
+		slots[j] = h->slots[i];
+	}
+	free(h->slots);
+	h->slots = slots;
+	h->capacity = capacity;
+	h->shift = shift;
+	return true;
+}
+
+/* make room for n more bytes in the arena */
+static bool arena_reserve(str_hash *h, size_t n)
+{
+	size_t size = h->arena_size;
+	unsigned char *arena;
+
+	if(h->arena_used + n <= size)
+		return true;
+	if(h->arena_used + n > STR_MAX_ARENA)
+		return false;
+	while(h->arena_used + n > size)
+		size *= 2;
+	arena = (unsigned char *)realloc(h->arena, size);
+	if(!arena) return false;
+	h->arena = arena;
+	h->arena_size = size;
+	return true;
+}
+
+/* make room for one more id */
+static bool ids_reserve(str_hash *h)
+{
+	size_t size = 2 * h->ids_size;
+	uint64_t *offsets;
+	unsigned char *values;
+
+	if(h->free_id != STR_NO_ID || h->nids < h->ids_size)
+		return true;
+	offsets = (uint64_t *)realloc(h->offsets, size * sizeof(uint64_t));
+	if(!offsets) return false;
+	h->offsets = offsets;
+	if(h->value_size) {
+		values = (unsigned char *)realloc(h->values,
+				size * h->value_size);
+		if(!values) return false;
+		h->values = values;
+	}
+	h->ids_size = size;
+	return true;
+}
+
+/* copy the live entries to a new arena, dropping the dead ones */
+static void arena_compact(str_hash *h)
+{
+	unsigned char *arena = (unsigned char *)malloc(h->arena_size);
+	size_t used = 0, off, i;
+
+	/* leave the arena as it is if there is no memory to spare */
+	if(!arena) return;
+	for(off = 0; off < h->arena_used;) {
+		const struct str_entry *e = entry_at(h, off);
+		size_t size = entry_size(e->len);
+		if(e->id != STR_EMPTY) {
+			memcpy(arena + used, e, size);
+			h->offsets[e->id] = used;
+			used += size;
+		}
+		off += size;
+	}
+	for(i = 0; i < h->capacity; i++)
+		if(h->slots[i].len != STR_EMPTY)
+			h->slots[i].offset = (uint32_t)(h->offsets[
+					entry_of(h, &h->slots[i])->id] / STR_UNIT);
+	free(h->arena);
+	h->arena = arena;
+	h->arena_used = used;
+	h->arena_dead = 0;
+}
+
+str_hash *str_init(size_t size, size_t value_size)
+{
+	str_hash *h = (str_hash *)calloc(1, sizeof(str_hash));
+	size_t capacity = 2;
+	int shift = 63;
+
+	if(!h) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	if(!size)
+		size = HASH_INIT_SIZE;
+	while(capacity * STR_MAX_LOAD < size) {
+		capacity *= 2;
+		shift--;
+	}
+	h->slots = slots_alloc(capacity);
+	h->capacity = capacity;
+	h->shift = shift;
+	h->arena_size = HASH_SLAB_SIZE;
+	h->arena = (unsigned char *)malloc(h->arena_size);
+	h->ids_size = 64;
+	h->offsets = (uint64_t *)malloc(h->ids_size * sizeof(uint64_t));
+	h->free_id = STR_NO_ID;
+	h->value_size = value_size;
+	if(value_size)
+		h->values = (unsigned char *)malloc(h->ids_size * value_size);
+	if(!h->slots || !h->arena || !h->offsets ||
+			(value_size && !h->values)) {
+		hash_error("failed to allocate memory");
+		str_free(h);
+		return NULL;
+	}
+	return h;
+}
+
+bool str_intern(str_hash *h, const char *s, size_t len, size_t *id)
+{
+	if(!h || (!s && len) || len >= STR_EMPTY) return false;
+	uint64_t code = str_code(s, len);
+	struct str_slot *slot = str_find(h, s, (uint32_t)len, code);
+	size_t size = entry_size(len), new_id;
+	struct str_entry *e;
+
+	if(slot->len != STR_EMPTY) {
+		if(id)
+			*id = entry_of(h, slot)->id;
+		return true;
+	}
+	if(!ids_reserve(h) || !arena_reserve(h, size))
+		goto FAILED;
+	if(h->nmembs + 1 > h->capacity * STR_MAX_LOAD) {
+		if(!str_grow(h))
+			goto FAILED;
+		slot = str_find(h, s, (uint32_t)len, code);
+	}
+
+	if(h->free_id != STR_NO_ID) {
+		new_id = (size_t)h->free_id;
+		h->free_id = h->offsets[new_id] & ~STR_FREE;
+	} else {
+		new_id = h->nids++;
+	}
+	e = entry_at(h, h->arena_used);
+	e->id = (uint32_t)new_id;
+	e->len = (uint32_t)len;
+	if(len)
+		memcpy(e->bytes, s, len);
+	e->bytes[len] = '\0';
+	slot->code = code;
+	slot->len = (uint32_t)len;
+	slot->offset = (uint32_t)(h->arena_used / STR_UNIT);
+	h->offsets[new_id] = h->arena_used;
+	if(h->value_size)
+		memset(h->values + new_id * h->value_size, 0, h->value_size);
+	h->arena_used += size;
+	if(id)
+		*id = new_id;
+	h->nmembs++;
+	return true;
+FAILED:
+	hash_error("failed to allocate memory");
+	return false;
+}
+
+bool str_lookup(const str_hash *h, const char *s, size_t len, size_t *id)
+{
+	if(!h || (!s && len) || len >= STR_EMPTY) return false;
+	struct str_slot *slot = str_find(h, s, (uint32_t)len,
+			str_code(s, len));
+	if(slot->len == STR_EMPTY)
+		return false;
+	if(id)
+		*id = entry_of(h, slot)->id;
+	return true;
+}
+
+bool str_put(str_hash *h, const char *s, size_t len, const void *value)
+{
+	size_t id;
+
+	if(!h || !h->value_size || !str_intern(h, s, len, &id))
+		return false;
+	memcpy(h->values + id * h->value_size, value, h->value_size);
+	return true;
+}
+
+bool str_delete(str_hash *h, const char *s, size_t len)
+{
+	if(!h || (!s && len) || len >= STR_EMPTY) return false;
+	struct str_slot *slot = str_find(h, s, (uint32_t)len,
+			str_code(s, len));
+	size_t mask = h->capacity - 1, i, j;
+	struct str_entry *e;
+
+	if(slot->len == STR_EMPTY)
+		return false;
+	e = entry_of(h, slot);
+	h->offsets[e->id] = STR_FREE | h->free_id;
+	h->free_id = e->id;
+	e->id = STR_EMPTY;
+	h->arena_dead += entry_size(e->len);
+	/* shift back the records that probed past the emptied slot */
+	i = (size_t)(slot - h->slots);
+	for(j = (i + 1) & mask; h->slots[j].len != STR_EMPTY;
+			j = (j + 1) & mask) {
+		size_t home = home_of(h, h->slots[j].code);
+		/* the record stays if its home lies in (i, j], cyclically */
+		if(((j - home) & mask) < ((j - i) & mask))
+			continue;
+		h->slots[i] = h->slots[j];
+		i = j;
+	}
+	h->slots[i].len = STR_EMPTY;
+	h->nmembs--;
+	if(h->arena_dead > h->arena_used / 2)
+		arena_compact(h);
+	return true;
+}
+
+const char *str_get(const str_hash *h, size_t id, size_t *len)
+{
+	if(!h || id >= h->nids || (h->offsets[id] & STR_FREE)) return NULL;
+	const struct str_entry *e = entry_at(h, h->offsets[id]);
+	if(len)
+		*len = e->len;
+	return e->bytes;
+}
+
+void *str_value(const str_hash *h, size_t id)
+{
+	if(!h || !h->value_size || id >= h->nids ||
+			(h->offsets[id] & STR_FREE))
+		return NULL;
+	return h->values + id * h->value_size;
+}
+
+size_t str_nmembs(const str_hash *h)
+{
+	return h ? h->nmembs : 0;
+}
+
+size_t str_bytes(const str_hash *h)
+{
+	if(!h) return 0;
+	return sizeof(str_hash) + h->capacity * sizeof(struct str_slot) +
+		h->arena_size + h->ids_size * (sizeof(uint64_t) + h->value_size);
+}
+
+void str_free(str_hash *h)
+{
+	if(!h) return;
+	free(h->slots);
+	free(h->arena);
+	free(h->offsets);
+	free(h->values);
+	free(h);
+}
@@ -0,0 +1,145 @@
+#include "hash_str.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define MAXSIZE (1<<18)
+
+int main(void)
+{
+	str_hash *h;
+	char buf[64];
+	const char *s;
+	size_t i, id, len;
+
+	h = str_init(16, sizeof(long));
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		len = (size_t)sprintf(buf, "http://example.com/%zu", i);
+		if(!str_intern(h, buf, len, &id) || id != i) {
+			fprintf(stderr, "intern error\n");
+			goto FAILED;
+		}
+	}
+	/* interning again gives the same id */
+	for(i = 0; i < MAXSIZE; i += 3) {
+		len = (size_t)sprintf(buf, "http://example.com/%zu", i);
+		if(!str_intern(h, buf, len, &id) || id != i) {
+			fprintf(stderr, "intern error\n");
+			goto FAILED;
+		}
+	}
+	if(str_nmembs(h) != MAXSIZE) {
+		fprintf(stderr, "intern error\n");
+		goto FAILED;
+	}
+
+	for(i = 0; i < 2 * MAXSIZE; i++) {
+		len = (size_t)sprintf(buf, "http://example.com/%zu", i);
+		bool found = str_lookup(h, buf, len, &id);
+		if(found != (i < MAXSIZE) || (found && id != i)) {
+			fprintf(stderr, "lookup error\n");
+			goto FAILED;
+		}
+		/* a prefix is a different string */
+		if(str_lookup(h, buf, len - 1, &id) && i >= 10 && i < MAXSIZE &&
+				id != i / 10) {
+			fprintf(stderr, "lookup error\n");
+			goto FAILED;
+		}
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		len = (size_t)sprintf(buf, "http://example.com/%zu", i);
+		s = str_get(h, i, &id);
+		if(!s || id != len || strcmp(s, buf) != 0) {
+			fprintf(stderr, "get error\n");
+			goto FAILED;
+		}
+	}
+	if(str_get(h, MAXSIZE, NULL) != NULL) {
+		fprintf(stderr, "get error\n");
+		goto FAILED;
+	}
+
+	/* the empty string is a string too */
+	if(str_lookup(h, "", 0, &id) || !str_intern(h, "", 0, &id) ||
+			id != MAXSIZE || !str_lookup(h, NULL, 0, &id) ||
+			id != MAXSIZE) {
+		fprintf(stderr, "intern error\n");
+		goto FAILED;
+	}
+
+	/* values, and deletion of every other string */
+	for(i = 0; i < MAXSIZE; i++) {
+		long value = -(long)i;
+		len = (size_t)sprintf(buf, "http://example.com/%zu", i);
+		if(!str_put(h, buf, len, &value) ||
+				*(long *)str_value(h, i) != -(long)i) {
+			fprintf(stderr, "put error\n");
+			goto FAILED;
+		}
+	}
+	for(i = 0; i < MAXSIZE; i += 2) {
+		len = (size_t)sprintf(buf, "http://example.com/%zu", i);
+		if(!str_delete(h, buf, len) || str_delete(h, buf, len)) {
+			fprintf(stderr, "delete error\n");
+			goto FAILED;
+		}
+	}
+	if(str_nmembs(h) != MAXSIZE / 2 + 1 || str_get(h, 0, NULL) ||
+			str_value(h, 0)) {
+		fprintf(stderr, "delete error\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		len = (size_t)sprintf(buf, "http://example.com/%zu", i);
+		bool found = str_lookup(h, buf, len, &id);
+		if(found != (i % 2 == 1) || (found && (id != i ||
+				*(long *)str_value(h, id) != -(long)i ||
+				strcmp(str_get(h, id, NULL), buf) != 0))) {
+			fprintf(stderr, "delete error\n");
+			goto FAILED;
+		}
+	}
+	/* new strings reuse the ids given back, with zeroed values */
+	for(i = 0; i < MAXSIZE / 2; i++) {
+		len = (size_t)sprintf(buf, "ident_%zu", i);
+		if(!str_intern(h, buf, len, &id) || id > MAXSIZE ||
+				(id % 2 && id != MAXSIZE) ||
+				*(long *)str_value(h, id) != 0) {
+			fprintf(stderr, "intern error\n");
+			goto FAILED;
+		}
+	}
+	if(str_nmembs(h) != MAXSIZE + 1) {
+		fprintf(stderr, "intern error\n");
+		goto FAILED;
+	}
+	/* deleting them again compacts the arena, keeping the rest */
+	for(i = 0; i < MAXSIZE / 2; i++) {
+		len = (size_t)sprintf(buf, "ident_%zu", i);
+		if(!str_delete(h, buf, len)) {
+			fprintf(stderr, "delete error\n");
+			goto FAILED;
+		}
+	}
+	for(i = 1; i < MAXSIZE; i += 2) {
+		len = (size_t)sprintf(buf, "http://example.com/%zu", i);
+		if(!str_lookup(h, buf, len, &id) || id != i ||
+				*(long *)str_value(h, id) != -(long)i ||
+				strcmp(str_get(h, id, NULL), buf) != 0) {
+			fprintf(stderr, "compact error\n");
+			goto FAILED;
+		}
+	}
+	str_free(h);
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
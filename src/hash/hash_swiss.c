@@ -0,0 +1,321 @@
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ *    ctrl:  |h2|E |h2|D |E |h2| ... |E |   one byte per slot
+ *    slots: |d |  |d |  |  |d | ... |  |   data_size bytes per slot
+ *           \______ group of 16 ______/
+ *
+ * Every slot has a control byte: EMPTY, DELETED, or the low 7 bits
+ * (h2) of the hash of the data stored in it. The rest of the hash
+ * (h1) selects the first group to probe; groups are probed in
+ * triangular order, and the 16 control bytes of a group are compared
+ * against h2 at once, so a lookup usually touches one control group
+ * and one slot. Data is stored inline in the slot array.
+ */
+
+#define GROUP_SIZE 16
+#define CTRL_EMPTY ((unsigned char)0x80)
+#define CTRL_DELETED ((unsigned char)0xFE)
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct swiss {
+	unsigned char *ctrl;
+	unsigned char *slots;
+	size_t slot_size;
+	size_t ngroups;
+	/* number of EMPTY slots that may still be filled before the
+	 * load factor reaches 7/8 */
+	size_t growth_left;
+};
+
+static bool swiss_init(hash *h, struct hash_init *h_init);
+static bool swiss_insert(hash *h, const void *data);
+static bool swiss_delete(hash *h, void *data);
+static void *swiss_search(hash *h, const void *data);
+static void swiss_free(hash *h);
+static void swiss_stats(hash *h, struct hash_stats *st);
+static void *swiss_next(hash *h, struct hash_iter *it);
+static void *swiss_get_or_insert(hash *h, const void *key, bool *inserted);
+
+const struct hash_ops hash_swiss_ops = {
+	swiss_init,
+	swiss_insert,
+	swiss_delete,
+	swiss_search,
+	swiss_free,
+	swiss_stats,
+	swiss_next,
+	swiss_get_or_insert,
+};
+
+/* bit i set if ctrl[i] == c */
+static unsigned int group_match(const unsigned char *ctrl, unsigned char c)
+{
+#ifdef __SSE2__
+	__m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+	return (unsigned int)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(g, _mm_set1_epi8((char)c)));
+#else
+	unsigned int mask = 0;
+	int i;
+	for(i = 0; i < GROUP_SIZE; i++)
+		if(ctrl[i] == c)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+/* bit i set if ctrl[i] is EMPTY or DELETED */
+static unsigned int group_match_free(const unsigned char *ctrl)
+{
+#ifdef __SSE2__
+	__m128i g = _mm_loadu_si128((const __m128i *)ctrl);
+	return (unsigned int)_mm_movemask_epi8(g);
+#else
+	unsigned int mask = 0;
+	int i;
+	for(i = 0; i < GROUP_SIZE; i++)
+		if(ctrl[i] & 0x80)
+			mask |= 1u << i;
+	return mask;
+#endif
+}
+
+static size_t capacity(const struct swiss *s)
+{
+	return s->ngroups * GROUP_SIZE;
+}
+
+static void *slot_at(const struct swiss *s, size_t i)
+{
+	return s->slots + i * s->slot_size;
+}
+
+/* allocate empty arrays for ngroups groups */
+static bool swiss_alloc(struct swiss *s, size_t ngroups)
+{
+	size_t cap = ngroups * GROUP_SIZE;
+	unsigned char *ctrl = (unsigned char *)malloc(cap);
+	unsigned char *slots = (unsigned char *)malloc(cap * s->slot_size);
+	if(!ctrl || !slots) {
+		free(ctrl);
+		free(slots);
+		return false;
+	}
+	memset(ctrl, CTRL_EMPTY, cap);
+	s->ctrl = ctrl;
+	s->slots = slots;
+	s->ngroups = ngroups;
+	s->growth_left = cap - cap / 8;
+	return true;
+}
+
+/* find the index of the slot holding data, or return -1 */
+static long swiss_find(hash *h, const void *data, uint64_t code)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	size_t mask = s->ngroups - 1;
+	size_t g = (size_t)(code >> 7) & mask;
+	unsigned char h2 = (unsigned char)(code & 0x7f);
+	size_t step = 0;
+
+	for(;;) {
+		const unsigned char *ctrl = s->ctrl + g * GROUP_SIZE;
+		unsigned int m = group_match(ctrl, h2);
+		while(m) {
+			size_t i = g * GROUP_SIZE + __builtin_ctz(m);
+			if(hash_cmp(h, slot_at(s, i), data) == 0) {
+				HASH_STAT(hash_count_lookup(h, true, step + 1));
+				return (long)i;
+			}
+			m &= m - 1;
+		}
+		if(group_match(ctrl, CTRL_EMPTY)) {
+			HASH_STAT(hash_count_lookup(h, false, step + 1));
+			return -1;
+		}
+		g = (g + ++step) & mask;
+	}
+}
+
+/* find the first EMPTY or DELETED slot on the probe sequence */
+static size_t swiss_find_free(const struct swiss *s, uint64_t code)
+{
+	size_t mask = s->ngroups - 1;
+	size_t g = (size_t)(code >> 7) & mask;
+	size_t step = 0;
+
+	for(;;) {
+		unsigned int m = group_match_free(s->ctrl + g * GROUP_SIZE);
+		if(m)
+			return g * GROUP_SIZE + __builtin_ctz(m);
+		g = (g + ++step) & mask;
+	}
+}
+
+/* move all data into arrays of ngroups groups, dropping DELETED marks */
+static bool swiss_rehash(hash *h, size_t ngroups)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	struct swiss old = *s;
+	size_t i;
+
+	if(!swiss_alloc(s, ngroups)) {
+		*s = old;
+		return false;
+	}
+	for(i = 0; i < capacity(&old); i++) {
+		if(old.ctrl[i] & 0x80)
+			continue;
+		void *data = slot_at(&old, i);
+		uint64_t code = hash_mix64(hash_code(h, data));
+		size_t j = swiss_find_free(s, code);
+		s->ctrl[j] = (unsigned char)(code & 0x7f);
+		memcpy(slot_at(s, j), data, s->slot_size);
+	}
+	s->growth_left -= h->nmembs;
+	free(old.ctrl);
+	free(old.slots);
+	return true;
+}
+
+bool swiss_init(hash *h, struct hash_init *h_init)
+{
+	struct swiss *s = (struct swiss *)malloc(sizeof(struct swiss));
+	size_t size = h_init->size ? h_init->size : HASH_INIT_SIZE;
+	size_t ngroups = 1;
+	size_t align = 1;
+
+	if(!s) return false;
+	while(ngroups * GROUP_SIZE < size)
+		ngroups *= 2;
+	/* keep each slot aligned for the largest scalar it may hold */
+	while(align < h->data_size && align < 8)
+		align *= 2;
+	s->slot_size = (h->data_size + align - 1) / align * align;
+	if(!swiss_alloc(s, ngroups)) {
+		free(s);
+		return false;
+	}
+	h->engine = s;
+	h->size = capacity(s);
+	return true;
+}
+
+/* find the slot holding data, or claim a free one for it */
+/* return the index of the slot, or -1 if failed */
+static long swiss_claim(hash *h, const void *data, bool *inserted)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, data));
+	long found = swiss_find(h, data, code);
+	*inserted = found < 0;
+	if(found >= 0)
+		return found;
+	size_t i = swiss_find_free(s, code);
+	if(s->ctrl[i] == CTRL_EMPTY && s->growth_left == 0) {
+		/* grow, or only drop DELETED marks if they fill the table */
+		size_t ngroups = s->ngroups;
+		if(h->nmembs >= capacity(s) * 7 / 16)
+			ngroups *= 2;
+		if(!swiss_rehash(h, ngroups)) {
+			hash_error("failed to allocate memory");
+			return -1;
+		}
+		h->size = capacity(s);
+		i = swiss_find_free(s, code);
+	}
+	if(s->ctrl[i] == CTRL_EMPTY)
+		s->growth_left--;
+	s->ctrl[i] = (unsigned char)(code & 0x7f);
+	h->nmembs++;
+	return (long)i;
+}
+
+bool swiss_insert(hash *h, const void *data)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	bool inserted;
+	long i = swiss_claim(h, data, &inserted);
+	if(i < 0)
+		return false;
+	memcpy(slot_at(s, i), data, h->data_size);
+	return true;
+}
+
+bool swiss_delete(hash *h, void *data)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, data));
+	long i = swiss_find(h, data, code);
+	if(i < 0)
+		return false;
+	memcpy(data, slot_at(s, i), h->data_size);
+	/* a lookup only walks past a group without EMPTY slots, so the
+	 * slot can be made EMPTY again if its group still has one */
+	if(group_match(s->ctrl + (i & ~(long)(GROUP_SIZE - 1)), CTRL_EMPTY)) {
+		s->ctrl[i] = CTRL_EMPTY;
+		s->growth_left++;
+	} else {
+		s->ctrl[i] = CTRL_DELETED;
+	}
+	h->nmembs--;
+	return true;
+}
+
+void *swiss_search(hash *h, const void *data)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	uint64_t code = hash_mix64(hash_code(h, data));
+	long i = swiss_find(h, data, code);
+	return i < 0 ? NULL : slot_at(s, i);
+}
+
+void swiss_free(hash *h)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	free(s->ctrl);
+	free(s->slots);
+	free(s);
+}
+
+void swiss_stats(hash *h, struct hash_stats *st)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	st->bytes += sizeof(struct swiss) +
+		capacity(s) * (1 + s->slot_size);
+}
+
+void *swiss_next(hash *h, struct hash_iter *it)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	while(it->pos < capacity(s)) {
+		size_t i = it->pos++;
+		if(!(s->ctrl[i] & 0x80))
+			return slot_at(s, i);
+	}
+	return NULL;
+}
+
+void *swiss_get_or_insert(hash *h, const void *key, bool *inserted)
+{
+	struct swiss *s = (struct swiss *)h->engine;
+	long i = swiss_claim(h, key, inserted);
+	if(i < 0)
+		return NULL;
+	if(*inserted) {
+		memcpy(slot_at(s, i), key, h->key_size);
+		memset((unsigned char *)slot_at(s, i) + h->key_size, 0,
+				h->data_size - h->key_size);
+	}
+	return slot_at(s, i);
+}
@@ -0,0 +1,124 @@
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <string.h>
+
+#define MAXSIZE (1<<20)
+int compare(const void *x, const void *y)
+{
+	const int *a = (int *)x;
+	const int *b = (int *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+int main(void)
+{
+	hash *h;
+	int i, tmp;
+	int *p;
+	struct hash_init h_init;
+
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.type = HASH_SWISS;
+	h_init.size = 16;
+	h_init.data_size = sizeof(int);
+	h_init.cmp_func = compare;
+	/* hash the bytes of data with hash_bytes */
+	h_init.hash_func = NULL;
+	h = hash_init(&h_init);
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	char tested[MAXSIZE];
+
+	memset(tested, 0, MAXSIZE);
+	for(i = 0; i < MAXSIZE; i++) {
+		if(!hash_insert(h, &i)) {
+			fprintf(stderr, "insert error\n");
+			goto FAILED;
+		}
+	}
+	/* inserting an equal element replaces it */
+	for(i = 0; i < MAXSIZE; i += 2) {
+		if(!hash_insert(h, &i)) {
+			fprintf(stderr, "insert error\n");
+			goto FAILED;
+		}
+	}
+	if(h->nmembs != MAXSIZE) {
+		fprintf(stderr, "insert error\n");
+		goto FAILED;
+	}
+
+	for(i = MAXSIZE - 1; i >= 0; i--) {
+		p = hash_search(h, &i);
+		if(p == NULL || *p != i) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+
+	srand((unsigned int)time(0));
+	for(i = 0; i < MAXSIZE / 2; i++) {
+		tmp = (int)rand() % MAXSIZE;
+		bool res = hash_delete(h, &tmp);
+		if(!res) {
+			if(!tested[tmp]) {
+				fprintf(stderr, "delete error\n");
+				goto FAILED;
+			}
+		} else {
+			if(tested[tmp]) {
+				fprintf(stderr, "delete error\n");
+				goto FAILED;
+			}
+			tested[tmp] = 1;
+		}
+	}
+
+	/* reinsert into slots freed by deletion */
+	for(i = 0; i < MAXSIZE; i++) {
+		if((hash_search(h, &i) == NULL) != tested[i]) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+		if(tested[i] && i % 2 == 0) {
+			if(!hash_insert(h, &i)) {
+				fprintf(stderr, "insert error\n");
+				goto FAILED;
+			}
+			tested[i] = 0;
+		}
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		if((hash_search(h, &i) == NULL) != tested[i]) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+	/* every element is visited once */
+	struct hash_iter it = { 0, NULL };
+	size_t count = 0;
+	while((p = hash_next(h, &it)) != NULL) {
+		if(tested[*p] || hash_search(h, p) != p) {
+			fprintf(stderr, "iteration error\n");
+			goto FAILED;
+		}
+		count++;
+	}
+	if(count != h->nmembs) {
+		fprintf(stderr, "iteration error\n");
+		goto FAILED;
+	}
+	hash_free(h);
+	puts("----------passed----------");
+	exit(EXIT_SUCCESS);
+FAILED:
+	puts("!!!!!!!!!!failed!!!!!!!!!!");
+	exit(EXIT_FAILURE);
+}
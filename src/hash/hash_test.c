@@ -5,7 +5,7 @@
 #include <time.h>
 #include <string.h>
 
-#define MAXSIZE 1<<20
+#define MAXSIZE (1<<20)
 int compare(const void *x, const void *y)
 {
 	const int *a = (int *)x;
@@ -15,18 +15,54 @@ int compare(const void *x, const void *y)
 	return -1;
 }
 
-int hash_key(const void *data)
+uint64_t hash_key(const void *data)
 {
 	return *(int *)data;
 }
 
+void sum_key(void *data, void *arg)
+{
+	*(long *)arg += *(int *)data;
+}
+
+/* the reference wyhash test vectors: message i hashed with seed i */
+bool check_vectors(void)
+{
+	static const char *msg[] = {
+		"", "a", "abc", "message digest",
+		"abcdefghijklmnopqrstuvwxyz",
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789",
+		"1234567890123456789012345678901234567890"
+		"1234567890123456789012345678901234567890"
+	};
+	static const uint64_t code[] = {
+		0x93228a4de0eec5a2ULL, 0xc5bac3db178713c4ULL,
+		0xa97f2f7b1d9b3314ULL, 0x786d1f1df3801df4ULL,
+		0xdca5a8138ad37c87ULL, 0xb9e734f117cfaf70ULL,
+		0x6cc5eab49a92d617ULL
+	};
+	const uint16_t one = 1;
+	size_t i;
+
+	/* hash_bytes reads words in native order */
+	if(*(const unsigned char *)&one != 1)
+		return true;
+	for(i = 0; i < sizeof(code) / sizeof(code[0]); i++)
+		if(hash_bytes(msg[i], strlen(msg[i]), i) != code[i])
+			return false;
+	return true;
+}
+
 int main(void)
 {
 	hash *h;
 	int i, tmp;
 	struct hash_init h_init;
 
-	h_init.size = MAXSIZE;
+	memset(&h_init, 0, sizeof(h_init));
+	/* start small so that the table grows and shrinks */
+	h_init.size = 16;
+	h_init.min_load = 0.25;
 	h_init.data_size = sizeof(int);
 	h_init.cmp_func = compare;
 	h_init.hash_func = hash_key;
@@ -37,6 +73,11 @@ int main(void)
 	}
 	char tested[MAXSIZE];
 
+	if(!check_vectors()) {
+		fprintf(stderr, "hash_bytes error\n");
+		goto FAILED;
+	}
+
 	memset(tested, 0, MAXSIZE);
 	for(i = 0; i < MAXSIZE; i++) {
 		if(!hash_insert(h, &i)) {
@@ -51,6 +92,44 @@ int main(void)
 			goto FAILED;
 		}
 	}
+	if(h->nmembs != MAXSIZE || h->size < MAXSIZE) {
+		fprintf(stderr, "resize error\n");
+		goto FAILED;
+	}
+
+	int *keys = (int *)malloc(MAXSIZE * sizeof(int));
+	void **results = (void **)malloc(MAXSIZE * sizeof(void *));
+	if(!keys || !results) {
+		fprintf(stderr, "failed to allocate memory\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++)
+		keys[i] = i + MAXSIZE / 2;
+	if(hash_search_batch(h, keys, MAXSIZE, results) != MAXSIZE / 2) {
+		fprintf(stderr, "batch search error\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		if(i < MAXSIZE / 2 ? *(int *)results[i] != keys[i] :
+				results[i] != NULL) {
+			fprintf(stderr, "batch search error\n");
+			goto FAILED;
+		}
+	}
+	if(hash_insert_batch(h, keys + MAXSIZE / 2, 1000) != 1000 ||
+			h->nmembs != MAXSIZE + 1000) {
+		fprintf(stderr, "batch insert error\n");
+		goto FAILED;
+	}
+	for(i = MAXSIZE; i < MAXSIZE + 1000; i++) {
+		tmp = i;
+		if(!hash_delete(h, &tmp)) {
+			fprintf(stderr, "batch insert error\n");
+			goto FAILED;
+		}
+	}
+	free(keys);
+	free(results);
 
 	srand((unsigned int)time(0));
 	for(i = 0; i < MAXSIZE / 2; i++) {
@@ -69,6 +148,116 @@ int main(void)
 			tested[tmp] = 1;
 		}
 	}
+
+	for(i = 0; i < MAXSIZE; i++) {
+		if((hash_search(h, &i) == NULL) != tested[i]) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+
+	struct hash_stats st;
+	size_t buckets = 0, nodes = 0;
+	if(!hash_stats(h, &st) || st.nmembs != h->nmembs ||
+			st.bytes <= h->size * sizeof(hash_slot)) {
+		fprintf(stderr, "stats error\n");
+		goto FAILED;
+	}
+	for(i = 0; i < HASH_HIST_SIZE; i++) {
+		buckets += st.hist[i];
+		nodes += i * st.hist[i];
+	}
+	if(buckets != h->size + h->old_size - h->rehash_idx ||
+			(st.max_chain < HASH_HIST_SIZE - 1 && nodes != h->nmembs)) {
+		fprintf(stderr, "stats error\n");
+		goto FAILED;
+	}
+
+	/* delete almost everything to let the table shrink, */
+	/* by at most half per delete */
+	for(i = 16; i < MAXSIZE; i++) {
+		size_t size = h->size;
+		hash_delete(h, &i);
+		if(h->size < size / 2) {
+			fprintf(stderr, "resize error\n");
+			goto FAILED;
+		}
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		if((hash_search(h, &i) == NULL) != (tested[i] || i >= 16)) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
+	if(h->size >= MAXSIZE) {
+		fprintf(stderr, "resize error\n");
+		goto FAILED;
+	}
+	/* the few survivors move to one block at the initial size */
+	tmp = (int)h->nmembs;
+	if(!hash_compact(h) || h->old_table || h->size != h->init_size ||
+			(int)h->nmembs != tmp) {
+		fprintf(stderr, "compact error\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		if((hash_search(h, &i) == NULL) != (tested[i] || i >= 16)) {
+			fprintf(stderr, "compact error\n");
+			goto FAILED;
+		}
+	}
+	hash_free(h);
+
+	/* build from an array holding every key twice */
+	keys = (int *)malloc(MAXSIZE * sizeof(int));
+	if(!keys) {
+		fprintf(stderr, "failed to allocate memory\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++)
+		keys[i] = i % (MAXSIZE / 2);
+	h = hash_build(&h_init, keys, MAXSIZE);
+	free(keys);
+	if(!h || h->nmembs != MAXSIZE / 2 || h->nmembs > h->max_load * h->size) {
+		fprintf(stderr, "build error\n");
+		goto FAILED;
+	}
+	for(i = 0; i < MAXSIZE; i++) {
+		if((hash_search(h, &i) == NULL) != (i >= MAXSIZE / 2)) {
+			fprintf(stderr, "build error\n");
+			goto FAILED;
+		}
+	}
+	long sum = 0;
+	hash_foreach(h, sum_key, &sum);
+	if(sum != (long)(MAXSIZE / 2) * (MAXSIZE / 2 - 1) / 2) {
+		fprintf(stderr, "iteration error\n");
+		goto FAILED;
+	}
+	hash_free(h);
+
+	/* in the middle of a resize, migrated old buckets are not counted */
+	h = hash_init(&h_init);
+	if(!h) {
+		fprintf(stderr, "failed to initialize hash\n");
+		goto FAILED;
+	}
+	for(i = 0; !h->old_table || h->rehash_idx == 0; i++) {
+		if(!hash_insert(h, &i)) {
+			fprintf(stderr, "insert error\n");
+			goto FAILED;
+		}
+	}
+	if(!hash_stats(h, &st)) {
+		fprintf(stderr, "stats error\n");
+		goto FAILED;
+	}
+	for(i = 0, buckets = 0; i < HASH_HIST_SIZE; i++)
+		buckets += st.hist[i];
+	if(buckets != h->size + h->old_size - h->rehash_idx) {
+		fprintf(stderr, "stats error\n");
+		goto FAILED;
+	}
 	hash_free(h);
 	puts("----------passed----------");
 	exit(EXIT_SUCCESS);
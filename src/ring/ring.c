@@ -0,0 +1,225 @@
+#include "ring.h"
+#include "hash.h"
+#include "skip-list/skiplist.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * The point of replica i of node is hash_mix64(node << 32 | i). As
+ * hash_mix64 is a bijection, no two points are equal, and they are
+ * ordered by hash alone. The weights of the nodes are kept in a map
+ * from node to weight, to know which points to remove.
+ */
+
+#define hash_error(E) fprintf(stderr, "%s:%d:%s: %s\n", \
+		__FILE__, __LINE__, __func__, E)
+
+struct point {
+	uint64_t hash;
+	uint32_t node;
+};
+
+struct ring {
+	skip_list *points;
+	/* node -> weight */
+	hash *nodes;
+	size_t vnodes;
+	/* element-sized buffer for hash_delete */
+	unsigned char *scratch;
+};
+
+static int point_cmp(const void *x, const void *y)
+{
+	const struct point *a = (const struct point *)x;
+	const struct point *b = (const struct point *)y;
+	if(a->hash > b->hash) return 1;
+	else if(a->hash == b->hash) return 0;
+	return -1;
+}
+
+static int node_cmp(const void *x, const void *y)
+{
+	const uint32_t *a = (const uint32_t *)x;
+	const uint32_t *b = (const uint32_t *)y;
+	if(*a > *b) return 1;
+	else if(*a == *b) return 0;
+	return -1;
+}
+
+static struct point point_of(uint32_t node, uint64_t replica)
+{
+	struct point p;
+	p.hash = hash_mix64((uint64_t)node << 32 | replica);
+	p.node = node;
+	return p;
+}
+
+/* remove the points of replicas from to to - 1 of node */
+static void remove_points(ring *r, uint32_t node, uint64_t from,
+		uint64_t to)
+{
+	struct point p;
+	for(; from < to; from++) {
+		p = point_of(node, from);
+		skip_delete(r->points, &p);
+	}
+}
+
+static void forget(ring *r, uint32_t node)
+{
+	memcpy(r->scratch, &node, sizeof(node));
+	hash_delete(r->nodes, r->scratch);
+}
+
+ring *ring_init(size_t vnodes)
+{
+	ring *r = (ring *)malloc(sizeof(ring));
+	struct hash_init h_init;
+
+	if(!r) {
+		hash_error("failed to allocate memory");
+		return NULL;
+	}
+	memset(&h_init, 0, sizeof(h_init));
+	h_init.type = HASH_CHAINED;
+	h_init.key_size = sizeof(uint32_t);
+	h_init.value_size = sizeof(uint32_t);
+	h_init.cmp_func = node_cmp;
+	r->points = skip_init(sizeof(struct point), point_cmp);
+	r->nodes = hash_init(&h_init);
+	r->scratch = r->nodes ?
+		(unsigned char *)malloc(r->nodes->data_size) : NULL;
+	if(!r->points || !r->scratch) {
+		hash_error("failed to allocate memory");
+		skip_free(r->points);
+		hash_free(r->nodes);
+		free(r);
+		return NULL;
+	}
+	r->vnodes = vnodes ? vnodes : RING_VNODES;
+	return r;
+}
+
+bool ring_add(ring *r, uint32_t node, uint32_t weight)
+{
+	if(!weight) {
+		hash_error("weight of 0");
+		return false;
+	}
+	bool inserted;
+	uint32_t *w = (uint32_t *)hash_get_or_insert(r->nodes, &node,
+			&inserted);
+	uint64_t old, now, i;
+	struct point p;
+
+	if(!w) return false;
+	old = inserted ? 0 : (uint64_t)*w * r->vnodes;
+	now = (uint64_t)weight * r->vnodes;
+	if(now < old) {
+		remove_points(r, node, now, old);
+	} else {
+		for(i = old; i < now; i++) {
+			p = point_of(node, i);
+			if(!skip_insert(r->points, &p)) {
+				/* leave node as it was */
+				remove_points(r, node, old, i);
+				if(inserted)
+					forget(r, node);
+				return false;
+			}
+		}
+	}
+	*w = weight;
+	return true;
+}
+
+bool ring_remove(ring *r, uint32_t node)
+{
+	void *data = hash_find(r->nodes, &node);
+	uint32_t weight;
+
+	if(!data) return false;
+	weight = *(uint32_t *)hash_value(r->nodes, data);
+	remove_points(r, node, 0, (uint64_t)weight * r->vnodes);
+	forget(r, node);
+	return true;
+}
+
+bool ring_lookup(const ring *r, uint64_t key, uint32_t *node)
+{
+	struct point p;
+	const struct point *owner;
+
+	p.hash = hash_mix64(key);
+	owner = (const struct point *)skip_ceil(r->points, &p);
+	/* past the last point, wrap around to the first */
+	if(!owner)
+		owner = (const struct point *)skip_first(r->points);
+	if(!owner) return false;
+	*node = owner->node;
+	return true;
+}
+
+size_t ring_nodes(const ring *r)
+{
+	return r->nodes->nmembs;
+}
+
+size_t ring_points(const ring *r)
+{
+	return r->points->size;
+}
+
+void ring_free(ring *r)
+{
+	if(!r) return;
+	skip_free(r->points);
+	hash_free(r->nodes);
+	free(r->scratch);
+	free(r);
+}
+
+/* Lamping and Veach, "A Fast, Minimal Memory, Consistent Hash */
+/* Algorithm": key jumps forward from bucket to bucket, with the */
+/* probability of landing in [0, j) being b / j, until it passes n */
+uint32_t ring_jump(uint64_t key, uint32_t n)
+{
+	int64_t b = -1, j = 0;
+
+	while(j < n) {
+		b = j;
+		key = key * 2862933555777941757ULL + 1;
+		j = (int64_t)((b + 1) * ((double)(1LL << 31) /
+					(double)((key >> 33) + 1)));
+	}
+	return (uint32_t)b;
+}
+
+size_t ring_rendezvous(uint64_t key, const uint32_t *nodes,
+		const uint32_t *weights, size_t n)
+{
+	size_t i, best = 0;
+	double score, max = -HUGE_VAL;
+	uint64_t h;
+
+	key = hash_mix64(key);
+	for(i = 0; i < n; i++) {
+		h = hash_mix64(key ^ hash_mix64((uint64_t)nodes[i] + 1));
+		if(weights) {
+			/* with u uniform in (0, 1), -w / ln(u) is highest */
+			/* for node i with probability w_i / sum(w) */
+			double u = ((h >> 11) + 0.5) / 9007199254740992.0;
+			score = -(double)weights[i] / log(u);
+		} else {
+			score = (double)h;
+		}
+		if(score > max) {
+			max = score;
+			best = i;
+		}
+	}
+	return best;
+}
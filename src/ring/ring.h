@@ -0,0 +1,54 @@
+/* ring.h defines a consistent hash ring, which spreads keys over nodes
+ * (shards, workers, ...) that come and go.
+ *
+ * Each node owns vnodes * weight points of the ring, kept in order in
+ * a skip list (see skip-list/skiplist.h). A key goes to the node owning
+ * the first point at or after the hash of the key, wrapping around, so
+ * a lookup takes O(log n) time. Points depend only on the node and its
+ * replica number, so adding a node or raising its weight only moves
+ * keys onto the new points, and removing a node or lowering its weight
+ * only moves the keys of the points dropped.
+ *
+ * ring_jump and ring_rendezvous need no ring. Jump consistent hash maps
+ * keys to nodes numbered 0 to n - 1 in O(log n) time and no memory,
+ * but nodes can only be added or removed at the end. Rendezvous
+ * (highest random weight) hashing takes any set of weighted nodes, at
+ * O(n) time per key.
+ */
+
+#ifndef _RING_H
+#define _RING_H
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* points per unit of weight by default */
+#define RING_VNODES (160)
+
+typedef struct ring ring;
+
+/* vnodes is the number of points per unit of weight, 0 for */
+/* RING_VNODES. return NULL if failed */
+ring *ring_init(size_t vnodes);
+/* add node with weight, or set the weight of node if present */
+/* return false if weight is 0 or failed */
+bool ring_add(ring *r, uint32_t node, uint32_t weight);
+/* return true if node was found and removed */
+bool ring_remove(ring *r, uint32_t node);
+/* copy the node owning key to node */
+/* key is any 64-bit integer, such as a hash_bytes code */
+/* return false if the ring is empty */
+bool ring_lookup(const ring *r, uint64_t key, uint32_t *node);
+size_t ring_nodes(const ring *r);
+size_t ring_points(const ring *r);
+void ring_free(ring *r);
+
+/* jump consistent hash: the node in [0, n) owning key, n > 0 */
+uint32_t ring_jump(uint64_t key, uint32_t n);
+/* rendezvous hash: the index in nodes of the node owning key, n > 0 */
+/* weights may be NULL for equal weights */
+size_t ring_rendezvous(uint64_t key, const uint32_t *nodes,
+		const uint32_t *weights, size_t n);
+
+#endif
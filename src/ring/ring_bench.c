@@ -0,0 +1,100 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ring.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/*
+ * Lookup throughput and load balance of the ring, jump and rendezvous
+ * hashing over NNODES nodes of equal weight. Balance is the largest
+ * number of keys of a node over the mean, and stddev is relative to
+ * the mean; moved is the share of keys that change node when node
+ * NNODES is added, the least possible being 1 / (NNODES + 1).
+ */
+
+#define NKEYS (1<<20)
+#define NNODES 64
+
+enum { RING, JUMP, RENDEZVOUS };
+
+static ring *r;
+static uint32_t nodes[NNODES + 1];
+
+double now(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+uint32_t lookup(int method, uint64_t key, uint32_t n)
+{
+	uint32_t node = 0;
+
+	switch(method) {
+	case RING:
+		ring_lookup(r, key, &node);
+		return node;
+	case JUMP:
+		return ring_jump(key, n);
+	default:
+		return nodes[ring_rendezvous(key, nodes, NULL, n)];
+	}
+}
+
+int main(void)
+{
+	static const char *names[] = {"ring", "jump", "rendezvous"};
+	uint32_t *owner = malloc(NKEYS * sizeof(uint32_t));
+	size_t count[NNODES], i, max, moved;
+	double start, elapsed, var;
+	int method;
+
+	r = ring_init(0);
+	if(!owner || !r) {
+		fprintf(stderr, "failed to allocate memory\n");
+		exit(EXIT_FAILURE);
+	}
+	for(i = 0; i <= NNODES; i++)
+		nodes[i] = (uint32_t)i;
+	for(i = 0; i < NNODES; i++)
+		ring_add(r, (uint32_t)i, 1);
+
+	printf("%d nodes, %d points per node in the ring\n",
+			NNODES, RING_VNODES);
+	printf("%-12s %12s %8s %8s %8s\n",
+			"", "lookup", "balance", "stddev", "moved");
+	for(method = RING; method <= RENDEZVOUS; method++) {
+		memset(count, 0, sizeof(count));
+		start = now();
+		for(i = 0; i < NKEYS; i++)
+			owner[i] = lookup(method, hash_mix64(i), NNODES);
+		elapsed = now() - start;
+		for(i = 0; i < NKEYS; i++)
+			count[owner[i]]++;
+		for(i = 0, max = 0, var = 0; i < NNODES; i++) {
+			double d = (double)count[i] - (double)NKEYS / NNODES;
+			if(count[i] > max)
+				max = count[i];
+			var += d * d;
+		}
+
+		if(method == RING)
+			ring_add(r, NNODES, 1);
+		for(i = 0, moved = 0; i < NKEYS; i++)
+			moved += lookup(method, hash_mix64(i), NNODES + 1) !=
+				owner[i];
+		printf("%-12s %8.2f M/s %8.3f %8.3f %8.4f\n", names[method],
+				NKEYS / elapsed / 1e6,
+				(double)max * NNODES / NKEYS,
+				sqrt(var / NNODES) * NNODES / NKEYS,
+				(double)moved / NKEYS);
+	}
+	printf("least moved: %.4f\n", 1.0 / (NNODES + 1));
+	ring_free(r);
+	free(owner);
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,170 @@
+#include "ring.h"
+#include "hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define NKEYS (1<<16)
+#define NNODES 10
+#define VNODES 100
+
+static uint32_t before[NKEYS];
+
+/* owner of key found by scanning every point of nodes 0 to n - 1 */
+uint32_t owner(uint64_t key, const uint32_t *weights, uint32_t n)
+{
+	uint64_t h = hash_mix64(key), p, best = 0, first = UINT64_MAX;
+	uint32_t node, best_node = 0, first_node = 0, i;
+	bool found = false;
+
+	for(node = 0; node < n; node++) {
+		for(i = 0; i < weights[node] * VNODES; i++) {
+			p = hash_mix64((uint64_t)node << 32 | i);
+			if(p < first) {
+				first = p;
+				first_node = node;
+			}
+			if(p >= h && (!found || p < best)) {
+				found = true;
+				best = p;
+				best_node = node;
+			}
+		}
+	}
+	return found ? best_node : first_node;
+}
+
+int main(void)
+{
+	uint32_t weights[NNODES + 1], nodes[NNODES + 1], node;
+	size_t count[NNODES + 1], moved, total = 0;
+	ring *r;
+	uint64_t k;
+	int i;
+
+	r = ring_init(VNODES);
+	if(!r) {
+		fprintf(stderr, "failed to initialize ring\n");
+		goto FAILED;
+	}
+	if(ring_lookup(r, 1, &node) || ring_add(r, 1, 0)) {
+		fprintf(stderr, "add error\n");
+		goto FAILED;
+	}
+	for(i = 0; i < NNODES; i++) {
+		weights[i] = i % 3 == 0 ? 3 : 1;
+		total += weights[i];
+		if(!ring_add(r, i, weights[i])) {
+			fprintf(stderr, "add error\n");
+			goto FAILED;
+		}
+	}
+	if(ring_nodes(r) != NNODES || ring_points(r) != total * VNODES) {
+		fprintf(stderr, "add error\n");
+		goto FAILED;
+	}
+	/* lookups match a scan of the points, and follow the weights */
+	memset(count, 0, sizeof(count));
+	for(k = 0; k < NKEYS; k++) {
+		if(!ring_lookup(r, k, &before[k]) || (k % 64 == 0 &&
+					before[k] != owner(k, weights, NNODES))) {
+			fprintf(stderr, "lookup error\n");
+			goto FAILED;
+		}
+		count[before[k]]++;
+	}
+	for(i = 0; i < NNODES; i++) {
+		double share = (double)count[i] / NKEYS * total / weights[i];
+		if(share < 0.7 || share > 1.3) {
+			fprintf(stderr, "node %d holds %zu keys\n", i, count[i]);
+			goto FAILED;
+		}
+	}
+
+	/* a new node only takes keys, and about its share of them */
+	weights[NNODES] = 1;
+	ring_add(r, NNODES, 1);
+	for(k = 0, moved = 0; k < NKEYS; k++) {
+		ring_lookup(r, k, &node);
+		if(node != before[k]) {
+			moved++;
+			if(node != NNODES)
+				goto MOVED;
+		}
+	}
+	if(moved < NKEYS / (total + 1) * 0.7 ||
+			moved > NKEYS / (total + 1) * 1.3)
+		goto MOVED;
+	/* removing it gives its keys back */
+	if(!ring_remove(r, NNODES) || ring_remove(r, NNODES))
+		goto MOVED;
+	for(k = 0; k < NKEYS; k++) {
+		ring_lookup(r, k, &node);
+		if(node != before[k])
+			goto MOVED;
+	}
+	/* changing a weight only moves keys to or from that node */
+	ring_add(r, 1, 2);
+	for(k = 0; k < NKEYS; k++) {
+		ring_lookup(r, k, &node);
+		if(node != before[k] && node != 1)
+			goto MOVED;
+	}
+	ring_add(r, 1, 1);
+	for(k = 0; k < NKEYS; k++) {
+		ring_lookup(r, k, &node);
+		if(node != before[k])
+			goto MOVED;
+	}
+	ring_remove(r, 0);
+	for(k = 0; k < NKEYS; k++) {
+		ring_lookup(r, k, &node);
+		if(node == 0 || (node != before[k] && before[k] != 0))
+			goto MOVED;
+	}
+	ring_free(r);
+	r = NULL;
+
+	/* jump hash: growing by one moves keys to the new node only */
+	for(k = 0, moved = 0; k < NKEYS; k++) {
+		uint64_t key = hash_mix64(k);
+		uint32_t a = ring_jump(key, NNODES);
+		uint32_t b = ring_jump(key, NNODES + 1);
+		if(a >= NNODES || (a != b && b != NNODES))
+			goto MOVED;
+		moved += a != b;
+	}
+	if(moved < NKEYS / 11 * 0.9 || moved > NKEYS / 11 * 1.1)
+		goto MOVED;
+
+	/* rendezvous: removing a node moves its keys only, */
+	/* and keys follow the weights */
+	for(i = 0; i < NNODES; i++)
+		nodes[i] = 100 + i;
+	memset(count, 0, sizeof(count));
+	for(k = 0; k < NKEYS; k++) {
+		size_t a = ring_rendezvous(k, nodes, weights, NNODES);
+		/* drop the last node */
+		size_t b = ring_rendezvous(k, nodes, weights, NNODES - 1);
+		if(a >= NNODES || (a != b && a != NNODES - 1))
+			goto MOVED;
+		count[a]++;
+	}
+	for(i = 0; i < NNODES; i++) {
+		double share = (double)count[i] / NKEYS * total / weights[i];
+		if(share < 0.9 || share > 1.1) {
+			fprintf(stderr, "node %d holds %zu keys\n", i, count[i]);
+			goto FAILED;
+		}
+	}
+	printf("----------passed----------\n");
+	return 0;
+
+MOVED:
+	fprintf(stderr, "keys moved wrongly\n");
+FAILED:
+	ring_free(r);
+	printf("----------failed----------\n");
+	return 1;
+}
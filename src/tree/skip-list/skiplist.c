@@ -31,6 +31,7 @@ skip_list *skip_init(size_t data_size, cmp_func f)
 		return NULL;
 	}
 
+	s->data_size = data_size;
 	nil = new_node(s, 0, NULL);
 	header = new_node(s, SKIP_MAX_LEVEL, NULL);
 	if(!nil || !header) {
@@ -46,7 +47,6 @@ skip_list *skip_init(size_t data_size, cmp_func f)
 
 	s->nil = nil;
 	s->header = header;
-	s->data_size = data_size;
 	s->size = 0;
 	s->level = 0;
 	s->compare = f;
@@ -71,6 +71,27 @@ const void *skip_search(const skip_list *s, const void *data)
 	return NULL;
 }
 
+const void *skip_ceil(const skip_list *s, const void *data)
+{
+	if(!s || !data) return NULL;
+
+	int i;
+	skip_node *x = s->header;
+
+	for(i = s->level; i >= 0; i--) {
+		while(compare(s, x->forwards[i], data) < 0)
+			x = x->forwards[i];
+	}
+	x = x->forwards[0];
+	return x == s->nil ? NULL : x->data;
+}
+
+const void *skip_first(const skip_list *s)
+{
+	if(!s || s->header->forwards[0] == s->nil) return NULL;
+	return s->header->forwards[0]->data;
+}
+
 skip_node *skip_insert(skip_list *s, const void *data)
 {
 	if(!s || !data) return NULL;
@@ -109,6 +130,7 @@ skip_node *skip_insert(skip_list *s, const void *data)
 			x->forwards[i] = update[i]->forwards[i];
 			update[i]->forwards[i] = x;
 		}
+		s->size++;
 	}
 	return x;
 }
@@ -133,12 +155,13 @@ bool skip_delete(skip_list *s, void *data)
 	/* x->data == data */
 	copy(data, x->data, s->data_size);
 
-	for(i = 0; i < s->level; i++) {
+	for(i = 0; i <= s->level; i++) {
 		if(update[i]->forwards[i] != x)
 			break;
 		update[i]->forwards[i] = x->forwards[i];
 	}
 	free_node(x);
+	s->size--;
 
 	while(s->level > 0 && s->header->forwards[s->level] == s->nil) {
 		s->header->forwards[s->level] = s->nil;
@@ -192,7 +215,11 @@ skip_node *new_node(const skip_list *s, int level, const void *data)
 		return NULL;
 	}
 
-	copy(node_data, data, s->data_size);
+	/* header and nil hold no data */
+	if(data)
+		copy(node_data, data, s->data_size);
+	else
+		memset(node_data, 0, s->data_size);
 	memset(forwards, 0, level * sizeof(skip_node *));
 
 	node->forwards = forwards;
@@ -37,6 +37,10 @@ typedef struct skip_list {
 
 extern skip_list *skip_init(size_t data_size, cmp_func f);
 extern const void *skip_search(const skip_list *s, const void *data);
+/* smallest data not less than data, or NULL if none */
+extern const void *skip_ceil(const skip_list *s, const void *data);
+/* smallest data, or NULL if empty */
+extern const void *skip_first(const skip_list *s);
 extern skip_node *skip_insert(skip_list *s, const void *data);
 extern bool skip_delete(skip_list *s, void *data);
 extern void skip_free(skip_list *s);
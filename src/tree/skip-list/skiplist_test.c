@@ -59,6 +59,28 @@ int main(void)
 			tested[tmp] = 1;
 		}
 	}
+
+	/* ceiling search skips the deleted keys */
+	const int *ceil;
+	for(i = 0, tmp = MAXSIZE; i < MAXSIZE; i++) {
+		if(!tested[i]) {
+			tmp = i;
+			break;
+		}
+	}
+	if(skip_first(s) == NULL || *(const int *)skip_first(s) != tmp) {
+		fprintf(stderr, "search error\n");
+		goto FAILED;
+	}
+	for(i = MAXSIZE - 1, tmp = MAXSIZE; i >= 0; i--) {
+		if(!tested[i])
+			tmp = i;
+		ceil = (const int *)skip_ceil(s, &i);
+		if(tmp == MAXSIZE ? ceil != NULL : !ceil || *ceil != tmp) {
+			fprintf(stderr, "search error\n");
+			goto FAILED;
+		}
+	}
 	skip_free(s);
 	puts("----------passed----------");
 	exit(EXIT_SUCCESS);